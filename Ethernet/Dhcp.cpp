@@ -3,42 +3,77 @@
 
 #include "w5100.h"
 
+#include <avr/eeprom.h>
 #include <string.h>
 #include <stdlib.h>
 #include "Dhcp.h"
 #include "Arduino.h"
 #include "util.h"
 
+DhcpClass::DhcpClass()
+{
+    _cacheAddress = -1;
+    _check = DHCP_CHECK_NONE;
+    _timeToLease = 0;
+}
+
 int DhcpClass::beginWithDHCP(uint8_t *mac, unsigned long timeout, unsigned long responseTimeout)
+{
+    int result = 0;
+
+    startDHCP(mac, timeout, responseTimeout);
+    if (_check != DHCP_CHECK_NONE)
+    {
+        while ((result = poll_DHCP_lease()) == 0)
+        {
+            delay(50);
+        }
+        _check = DHCP_CHECK_NONE;
+    }
+    return result == 1;
+}
+
+//start getting a lease without waiting, checkLease() carries it on
+void DhcpClass::startDHCP(uint8_t *mac, unsigned long timeout, unsigned long responseTimeout)
 {
     _dhcpLeaseTime=0;
     _dhcpT1=0;
     _dhcpT2=0;
     _lastCheck=0;
+    _renewInSec=0;
+    _rebindInSec=0;
+    _leaseInSec=0;
     _timeout = timeout;
     _responseTimeout = responseTimeout;
+    _check = DHCP_CHECK_NONE;
 
     // zero out _dhcpMacAddr
     memset(_dhcpMacAddr, 0, 6); 
     reset_DHCP_lease();
 
     memcpy((void*)_dhcpMacAddr, (void*)mac, 6);
-    _dhcp_state = STATE_DHCP_START;
-    return request_DHCP_lease();
+    // ask for the last address first, if we have one (INIT-REBOOT)
+    _dhcp_state = load_DHCP_lease() ? STATE_DHCP_REBOOT : STATE_DHCP_START;
+    if (start_DHCP_lease())
+    {
+        _check = DHCP_CHECK_LEASE_FAIL;
+    }
+}
+
+//keep each lease in EEPROM at address, or not if address is negative (the default)
+void DhcpClass::setLeaseCache(int address)
+{
+    _cacheAddress = address;
 }
 
 void DhcpClass::reset_DHCP_lease(){
     // zero out _dhcpSubnetMask, _dhcpGatewayIp, _dhcpLocalIp, _dhcpDhcpServerIp, _dhcpDnsServerIp
     memset(_dhcpLocalIp, 0, 20);
+    _leaseInSec = 0;
 }
 
-//return:0 on error, 1 if request is sent and response is received
-int DhcpClass::request_DHCP_lease(){
-    
-    uint8_t messageType = 0;
-  
-    
-  
+//return:0 if there is no socket for the exchange, else 1
+uint8_t DhcpClass::start_DHCP_lease(){
     // Pick an initial transaction ID
     _dhcpTransactionId = random(1UL, 2000UL);
     _dhcpInitialTransactionId = _dhcpTransactionId;
@@ -51,81 +86,147 @@ int DhcpClass::request_DHCP_lease(){
     }
     
     presend_DHCP();
-    
-    int result = 0;
-    
-    unsigned long startTime = millis();
-    
-    while(_dhcp_state != STATE_DHCP_LEASED)
+    _startTime = millis();
+    return 1;
+}
+
+//take the lease exchange one step further without waiting
+//return:1 once leased, -1 if there was no lease within the timeout, 0 while in progress
+int DhcpClass::poll_DHCP_lease(){
+    uint8_t messageType = 0;
+    uint32_t respId;
+
+    if(_dhcp_state == STATE_DHCP_START)
     {
-        if(_dhcp_state == STATE_DHCP_START)
+        _dhcpTransactionId++;
+        
+        send_DHCP_MESSAGE(DHCP_DISCOVER, ((millis() - _startTime) / 1000));
+        _dhcp_state = STATE_DHCP_DISCOVER;
+        _sendTime = millis();
+    }
+    else if(_dhcp_state == STATE_DHCP_REREQUEST || _dhcp_state == STATE_DHCP_REBOOT){
+        _dhcpTransactionId++;
+        send_DHCP_MESSAGE(DHCP_REQUEST, ((millis() - _startTime)/1000));
+        _dhcp_state = STATE_DHCP_REQUEST;
+        _sendTime = millis();
+    }
+    else if(_dhcp_state == STATE_DHCP_DISCOVER)
+    {
+        messageType = parseDHCPResponse(respId);
+        if(messageType == DHCP_OFFER)
         {
-            _dhcpTransactionId++;
-            
-            send_DHCP_MESSAGE(DHCP_DISCOVER, ((millis() - startTime) / 1000));
-            _dhcp_state = STATE_DHCP_DISCOVER;
-        }
-        else if(_dhcp_state == STATE_DHCP_REREQUEST){
-            _dhcpTransactionId++;
-            send_DHCP_MESSAGE(DHCP_REQUEST, ((millis() - startTime)/1000));
+            // We'll use the transaction ID that the offer came with,
+            // rather than the one we were up to
+            _dhcpTransactionId = respId;
+            send_DHCP_MESSAGE(DHCP_REQUEST, ((millis() - _startTime) / 1000));
             _dhcp_state = STATE_DHCP_REQUEST;
+            _sendTime = millis();
         }
-        else if(_dhcp_state == STATE_DHCP_DISCOVER)
+    }
+    else if(_dhcp_state == STATE_DHCP_REQUEST)
+    {
+        messageType = parseDHCPResponse(respId);
+        if(messageType == DHCP_ACK)
         {
-            uint32_t respId;
-            messageType = parseDHCPResponse(_responseTimeout, respId);
-            if(messageType == DHCP_OFFER)
-            {
-                // We'll use the transaction ID that the offer came with,
-                // rather than the one we were up to
-                _dhcpTransactionId = respId;
-                send_DHCP_MESSAGE(DHCP_REQUEST, ((millis() - startTime) / 1000));
-                _dhcp_state = STATE_DHCP_REQUEST;
+            _dhcp_state = STATE_DHCP_LEASED;
+            //use default lease time if we didn't get it
+            if(_dhcpLeaseTime == 0){
+                _dhcpLeaseTime = DEFAULT_LEASE;
             }
-        }
-        else if(_dhcp_state == STATE_DHCP_REQUEST)
-        {
-            uint32_t respId;
-            messageType = parseDHCPResponse(_responseTimeout, respId);
-            if(messageType == DHCP_ACK)
-            {
-                _dhcp_state = STATE_DHCP_LEASED;
-                result = 1;
-                //use default lease time if we didn't get it
-                if(_dhcpLeaseTime == 0){
-                    _dhcpLeaseTime = DEFAULT_LEASE;
-                }
-                //calculate T1 & T2 if we didn't get it
-                if(_dhcpT1 == 0){
-                    //T1 should be 50% of _dhcpLeaseTime
-                    _dhcpT1 = _dhcpLeaseTime >> 1;
-                }
-                if(_dhcpT2 == 0){
-                    //T2 should be 87.5% (7/8ths) of _dhcpLeaseTime
-                    _dhcpT2 = _dhcpT1 << 1;
-                }
-                _renewInSec = _dhcpT1;
-                _rebindInSec = _dhcpT2;
+            //calculate T1 & T2 if we didn't get it
+            if(_dhcpT1 == 0){
+                //T1 should be 50% of _dhcpLeaseTime
+                _dhcpT1 = _dhcpLeaseTime >> 1;
             }
-            else if(messageType == DHCP_NAK)
-                _dhcp_state = STATE_DHCP_START;
+            if(_dhcpT2 == 0){
+                //T2 should be 87.5% (7/8ths) of _dhcpLeaseTime
+                _dhcpT2 = _dhcpLeaseTime - (_dhcpLeaseTime >> 3);
+            }
+            _renewInSec = _dhcpT1;
+            _rebindInSec = _dhcpT2;
+            _leaseInSec = _dhcpLeaseTime;
+            _timeToLease = millis() - _startTime;
+            save_DHCP_lease();
+
+            // We're done with the socket now
+            _dhcpUdpSocket.stop();
+            _dhcpTransactionId++;
+            return 1;
         }
-        
-        if(messageType == 255)
+        else if(messageType == DHCP_NAK)
         {
-            messageType = 0;
+            // not our address (any more), find a new one
+            reset_DHCP_lease();
             _dhcp_state = STATE_DHCP_START;
         }
-        
-        if(result != 1 && ((millis() - startTime) > _timeout))
-            break;
     }
-    
-    // We're done with the socket now
-    _dhcpUdpSocket.stop();
-    _dhcpTransactionId++;
 
-    return result;
+    if((_dhcp_state == STATE_DHCP_DISCOVER || _dhcp_state == STATE_DHCP_REQUEST) &&
+       (millis() - _sendTime) > _responseTimeout)
+    {
+        if (_leaseInSec > 0)
+        {
+            // renewing or rebinding, the lease we have is good until it
+            // expires and checkLease() asks again later
+            _dhcpUdpSocket.stop();
+            _dhcpTransactionId++;
+            return -1;
+        }
+        // no answer, start again with a DISCOVER to any server
+        reset_DHCP_lease();
+        _dhcp_state = STATE_DHCP_START;
+    }
+
+    if((millis() - _startTime) > _timeout)
+    {
+        _dhcpUdpSocket.stop();
+        _dhcpTransactionId++;
+        return -1;
+    }
+    return 0;
+}
+
+//return:1 if a lease for our MAC address was read from EEPROM, else 0
+uint8_t DhcpClass::load_DHCP_lease(){
+    DHCP_LEASE_CACHE cache;
+    uint8_t *p = (uint8_t*)&cache;
+
+    if (_cacheAddress < 0)
+        return 0;
+    for (uint8_t i = 0; i < sizeof(cache); i++)
+    {
+        p[i] = eeprom_read_byte((uint8_t*)(_cacheAddress + i));
+    }
+    if (cache.magic != DHCP_CACHE_MAGIC || memcmp(cache.mac, _dhcpMacAddr, 6) != 0)
+        return 0;
+
+    memcpy(_dhcpLocalIp, cache.localIp, 4);
+    memcpy(_dhcpSubnetMask, cache.subnetMask, 4);
+    memcpy(_dhcpGatewayIp, cache.gatewayIp, 4);
+    memcpy(_dhcpDhcpServerIp, cache.dhcpServerIp, 4);
+    memcpy(_dhcpDnsServerIp, cache.dnsServerIp, 4);
+    return 1;
+}
+
+void DhcpClass::save_DHCP_lease(){
+    DHCP_LEASE_CACHE cache;
+    uint8_t *p = (uint8_t*)&cache;
+
+    if (_cacheAddress < 0)
+        return;
+    cache.magic = DHCP_CACHE_MAGIC;
+    memcpy(cache.mac, _dhcpMacAddr, 6);
+    memcpy(cache.localIp, _dhcpLocalIp, 4);
+    memcpy(cache.subnetMask, _dhcpSubnetMask, 4);
+    memcpy(cache.gatewayIp, _dhcpGatewayIp, 4);
+    memcpy(cache.dhcpServerIp, _dhcpDhcpServerIp, 4);
+    memcpy(cache.dnsServerIp, _dhcpDnsServerIp, 4);
+    // only write what changed, a renewal usually changes nothing
+    for (uint8_t i = 0; i < sizeof(cache); i++)
+    {
+        if (eeprom_read_byte((uint8_t*)(_cacheAddress + i)) != p[i])
+            eeprom_write_byte((uint8_t*)(_cacheAddress + i), p[i]);
+    }
 }
 
 void DhcpClass::presend_DHCP()
@@ -230,8 +331,8 @@ void DhcpClass::send_DHCP_MESSAGE(uint8_t messageType, uint16_t secondsElapsed)
         buffer[10] = _dhcpDhcpServerIp[2];
         buffer[11] = _dhcpDhcpServerIp[3];
 
-        //put data in W5100 transmit buffer
-        _dhcpUdpSocket.write(buffer, 12);
+        //put data in W5100 transmit buffer, without the server in INIT-REBOOT
+        _dhcpUdpSocket.write(buffer, _dhcp_state == STATE_DHCP_REBOOT ? 6 : 12);
     }
     
     buffer[0] = dhcpParamRequest;
@@ -250,20 +351,15 @@ void DhcpClass::send_DHCP_MESSAGE(uint8_t messageType, uint16_t secondsElapsed)
     _dhcpUdpSocket.endPacket();
 }
 
-uint8_t DhcpClass::parseDHCPResponse(unsigned long responseTimeout, uint32_t& transactionId)
+//return:the message type, or 0 if there is no message for us
+uint8_t DhcpClass::parseDHCPResponse(uint32_t& transactionId)
 {
     uint8_t type = 0;
     uint8_t opt_len = 0;
-     
-    unsigned long startTime = millis();
 
-    while(_dhcpUdpSocket.parsePacket() <= 0)
+    if(_dhcpUdpSocket.parsePacket() <= 0)
     {
-        if((millis() - startTime) > responseTimeout)
-        {
-            return 255;
-        }
-        delay(50);
+        return 0;
     }
     // start reading in the packet
     RIP_MSG_FIXED fixedMsg;
@@ -384,17 +480,42 @@ uint8_t DhcpClass::parseDHCPResponse(unsigned long responseTimeout, uint32_t& tr
 
 /*
     returns:
-    0/DHCP_CHECK_NONE: nothing happened
+    0/DHCP_CHECK_NONE: nothing happened, or an exchange is still in progress
     1/DHCP_CHECK_RENEW_FAIL: renew failed
     2/DHCP_CHECK_RENEW_OK: renew success
     3/DHCP_CHECK_REBIND_FAIL: rebind fail
     4/DHCP_CHECK_REBIND_OK: rebind success
+    5/DHCP_CHECK_LEASE_FAIL: no lease after startDHCP
+    6/DHCP_CHECK_LEASE_OK: lease after startDHCP
 */
 int DhcpClass::checkLease(){
     //this uses a signed / unsigned trick to deal with millis overflow
     unsigned long now = millis();
     signed long snow = (long)now;
     int rc=DHCP_CHECK_NONE;
+
+    //an exchange in progress goes one step further, each fail code is one less than its ok code
+    if (_check != DHCP_CHECK_NONE){
+        int result = poll_DHCP_lease();
+        if (result != 0){
+            rc = _check + (result == 1);
+            _check = DHCP_CHECK_NONE;
+            if (result != 1 && _leaseInSec > 0){
+                //keep the address until the lease expires, ask again in
+                //half the time left to T2 or to the end, at least a minute
+                _dhcp_state = STATE_DHCP_LEASED;
+                if (rc == DHCP_CHECK_RENEW_FAIL){
+                    _renewInSec = _rebindInSec > 120 ? _rebindInSec / 2 : 60;
+                }else{
+                    _rebindInSec = _leaseInSec > 120 ? _leaseInSec / 2 : 60;
+                    _renewInSec = _rebindInSec;
+                }
+            }else if (result != 1){
+                _dhcp_state = STATE_DHCP_START;
+            }
+        }
+    }
+
     if (_lastCheck != 0){
         signed long factor;
         //calc how many ms past the timeout we are
@@ -419,20 +540,39 @@ int DhcpClass::checkLease(){
                 _rebindInSec = 0;
             else
                 _rebindInSec -= factor;
+
+            if(_leaseInSec < factor*2 )
+                _leaseInSec = 0;
+            else
+                _leaseInSec -= factor;
         }
 
         //if we have a lease but should renew, do it
-        if (_dhcp_state == STATE_DHCP_LEASED && _renewInSec <=0){
+        if (_check == DHCP_CHECK_NONE && _dhcp_state == STATE_DHCP_LEASED && _renewInSec <=0){
             _dhcp_state = STATE_DHCP_REREQUEST;
-            rc = 1 + request_DHCP_lease();
+            if (start_DHCP_lease())
+                _check = DHCP_CHECK_RENEW_FAIL;
+            else
+                _dhcp_state = STATE_DHCP_LEASED;
+        }
+
+        //if we have a lease or are renewing but should bind, ask any server
+        //for our address, without the server identifier as in INIT-REBOOT
+        if( (_check == DHCP_CHECK_NONE || _check == DHCP_CHECK_RENEW_FAIL) && _rebindInSec <=0 && _leaseInSec > 0){
+            _dhcp_state = STATE_DHCP_REBOOT;
+            if (start_DHCP_lease())
+                _check = DHCP_CHECK_REBIND_FAIL;
+            else{
+                _check = DHCP_CHECK_NONE;
+                _dhcp_state = STATE_DHCP_LEASED;
+            }
         }
 
-        //if we have a lease or is renewing but should bind, do it
-        if( (_dhcp_state == STATE_DHCP_LEASED || _dhcp_state == STATE_DHCP_START) && _rebindInSec <=0){
-            //this should basically restart completely
+        //if the lease has run out, or there never was one, restart completely
+        if (_check == DHCP_CHECK_NONE && _leaseInSec <= 0){
             _dhcp_state = STATE_DHCP_START;
             reset_DHCP_lease();
-            rc = 3 + request_DHCP_lease();
+            _check = start_DHCP_lease() ? DHCP_CHECK_REBIND_FAIL : DHCP_CHECK_NONE;
         }
     }
     else{
@@ -468,6 +608,12 @@ IPAddress DhcpClass::getDnsServerIp()
     return IPAddress(_dhcpDnsServerIp);
 }
 
+//milliseconds from the start of the last successful exchange to its ACK
+unsigned long DhcpClass::getTimeToLease()
+{
+    return _timeToLease;
+}
+
 void DhcpClass::printByte(char * buf, uint8_t n ) {
   char *str = &buf[1];
   buf[0]='0';
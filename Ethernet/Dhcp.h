@@ -13,6 +13,7 @@
 #define	STATE_DHCP_LEASED	3
 #define	STATE_DHCP_REREQUEST	4
 #define	STATE_DHCP_RELEASE	5
+#define	STATE_DHCP_REBOOT	6
 
 #define DHCP_FLAGSBROADCAST	0x8000
 
@@ -52,6 +53,10 @@
 #define DHCP_CHECK_RENEW_OK     (2)
 #define DHCP_CHECK_REBIND_FAIL  (3)
 #define DHCP_CHECK_REBIND_OK    (4)
+#define DHCP_CHECK_LEASE_FAIL   (5)
+#define DHCP_CHECK_LEASE_OK     (6)
+
+#define DHCP_CACHE_MAGIC	0xD3	/* marks a valid lease in EEPROM */
 
 enum
 {
@@ -136,6 +141,18 @@ typedef struct _RIP_MSG_FIXED
 	uint8_t  chaddr[6];
 }RIP_MSG_FIXED;
 
+// Last lease, kept in EEPROM to ask for the same address after a reset
+typedef struct _DHCP_LEASE_CACHE
+{
+	uint8_t  magic;
+	uint8_t  mac[6];
+	uint8_t  localIp[4];
+	uint8_t  subnetMask[4];
+	uint8_t  gatewayIp[4];
+	uint8_t  dhcpServerIp[4];
+	uint8_t  dnsServerIp[4];
+}DHCP_LEASE_CACHE;
+
 class DhcpClass {
 private:
   uint32_t _dhcpInitialTransactionId;
@@ -150,28 +167,43 @@ private:
   uint32_t _dhcpT1, _dhcpT2;
   signed long _renewInSec;
   signed long _rebindInSec;
+  signed long _leaseInSec;
   signed long _lastCheck;
   unsigned long _timeout;
   unsigned long _responseTimeout;
   unsigned long _secTimeout;
+  unsigned long _startTime;
+  unsigned long _sendTime;
+  unsigned long _timeToLease;
+  int _cacheAddress;
   uint8_t _dhcp_state;
+  uint8_t _check;
   EthernetUDP _dhcpUdpSocket;
   
-  int request_DHCP_lease();
+  uint8_t start_DHCP_lease();
+  int poll_DHCP_lease();
   void reset_DHCP_lease();
   void presend_DHCP();
   void send_DHCP_MESSAGE(uint8_t, uint16_t);
   void printByte(char *, uint8_t);
+  uint8_t load_DHCP_lease();
+  void save_DHCP_lease();
   
-  uint8_t parseDHCPResponse(unsigned long responseTimeout, uint32_t& transactionId);
+  uint8_t parseDHCPResponse(uint32_t& transactionId);
 public:
+  DhcpClass();
+
   IPAddress getLocalIp();
   IPAddress getSubnetMask();
   IPAddress getGatewayIp();
   IPAddress getDhcpServerIp();
   IPAddress getDnsServerIp();
   
+  unsigned long getTimeToLease();
+  
   int beginWithDHCP(uint8_t *, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
+  void startDHCP(uint8_t *, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
+  void setLeaseCache(int address);
   int checkLease();
 };
 
@@ -41,6 +41,10 @@
 // Port number that DNS servers listen on
 #define DNS_PORT        53
 
+// Time to wait for each answer, and the number of times to ask
+#define DNS_TIMEOUT     5000
+#define DNS_TRIES       3
+
 // Possible return codes from ProcessResponse
 #define SUCCESS          1
 #define TIMED_OUT        -1
@@ -48,10 +52,128 @@
 #define TRUNCATED        -3
 #define INVALID_RESPONSE -4
 
+// Values for iState
+#define LOOKUP_IDLE      0
+#define LOOKUP_WAITING   1
+#define LOOKUP_DONE      2
+
+#if DNS_CACHE_SIZE
+// Shared by all DNSClients, as EthernetClient::connect() makes a new one
+// for every connection.  Names are kept as two hashes and a length to save
+// RAM, so that two names must collide in both hashes to be confused.
+struct DNSCacheEntry
+{
+    uint32_t hash;          // 0 for an unused or expired entry
+    uint16_t check;         // second hash of the name
+    uint8_t length;         // length of the name, modulo 256
+    unsigned long expires;
+    uint8_t address[4];
+};
+static DNSCacheEntry dnsCache[DNS_CACHE_SIZE];
+
+// FNV-1a hash of the name and a djb2 hash to check it, ignoring case as
+// DNS does
+static void hashName(const char* aName, DNSCacheEntry& aKey)
+{
+    uint32_t hash = 2166136261UL;
+    uint16_t check = 5381;
+    uint8_t length = 0;
+    while (*aName)
+    {
+        char c = *aName++;
+        if (c >= 'A' && c <= 'Z')
+        {
+            c += 'a' - 'A';
+        }
+        hash = (hash ^ (uint8_t)c) * 16777619UL;
+        check = (check << 5) + check + (uint8_t)c;
+        length++;
+    }
+    // 0 marks an unused entry
+    aKey.hash = hash ? hash : 1;
+    aKey.check = check;
+    aKey.length = length;
+}
+
+static DNSCacheEntry* cacheFind(const DNSCacheEntry& aKey)
+{
+    DNSCacheEntry* found = NULL;
+    unsigned long now = millis();
+    for (uint8_t i =0; i < DNS_CACHE_SIZE; i++)
+    {
+        // Mark every expired entry unused while it is seen as expired, as
+        // the signed difference wraps about 24 days after it expires
+        if (dnsCache[i].hash && (long)(dnsCache[i].expires - now) <= 0)
+        {
+            dnsCache[i].hash = 0;
+        }
+        if (dnsCache[i].hash == aKey.hash && dnsCache[i].check == aKey.check &&
+            dnsCache[i].length == aKey.length)
+        {
+            found = &dnsCache[i];
+        }
+    }
+    return found;
+}
+
+static void cacheStore(const char* aName, const IPAddress& aAddress, uint32_t aTTL)
+{
+    if (aTTL == 0)
+    {
+        return;
+    }
+    if (aTTL > DNS_CACHE_MAX_TTL)
+    {
+        aTTL = DNS_CACHE_MAX_TTL;
+    }
+    DNSCacheEntry key;
+    hashName(aName, key);
+    unsigned long now = millis();
+    // Replace the same name, else an unused entry, else the one that
+    // expires first.  cacheFind() has marked the expired ones unused, so
+    // the others are at most DNS_CACHE_MAX_TTL from expiring.
+    DNSCacheEntry* entry = cacheFind(key);
+    for (uint8_t i =0; !entry && i < DNS_CACHE_SIZE; i++)
+    {
+        if (!dnsCache[i].hash)
+        {
+            entry = &dnsCache[i];
+        }
+    }
+    if (!entry)
+    {
+        entry = &dnsCache[0];
+        for (uint8_t i =1; i < DNS_CACHE_SIZE; i++)
+        {
+            if (dnsCache[i].expires - now < entry->expires - now)
+            {
+                entry = &dnsCache[i];
+            }
+        }
+    }
+    entry->hash = key.hash;
+    entry->check = key.check;
+    entry->length = key.length;
+    entry->expires = now + aTTL*1000;
+    for (uint8_t i =0; i < 4; i++)
+    {
+        entry->address[i] = aAddress[i];
+    }
+}
+#endif
+
 void DNSClient::begin(const IPAddress& aDNSServer)
 {
     iDNSServer = aDNSServer;
     iRequestId = 0;
+    iState = LOOKUP_IDLE;
+}
+
+void DNSClient::clearCache()
+{
+#if DNS_CACHE_SIZE
+    memset(dnsCache, 0, sizeof(dnsCache));
+#endif
 }
 
 
@@ -117,58 +239,133 @@ int DNSClient::inet_aton(const char* aIPAddrString, IPAddress& aResult)
 
 int DNSClient::getHostByName(const char* aHostname, IPAddress& aResult)
 {
-    int ret =0;
+    int ret = beginHostByName(aHostname);
+
+    if (ret == 1)
+    {
+        // Now wait for a response
+        while ((ret = pollHostByName(aResult)) == 0)
+        {
+            delay(50);
+        }
+    }
+    return ret;
+}
+
+int DNSClient::beginHostByName(const char* aHostname)
+{
+    // Drop any lookup still in progress
+    iUdp.stop();
+    iState = LOOKUP_IDLE;
+    iHostname = aHostname;
 
     // See if it's a numeric IP address
-    if (inet_aton(aHostname, aResult))
+    if (inet_aton(aHostname, iResult))
     {
         // It is, our work here is done
+        iState = LOOKUP_DONE;
+        return 1;
+    }
+
+#if DNS_CACHE_SIZE
+    DNSCacheEntry key;
+    hashName(aHostname, key);
+    DNSCacheEntry* entry = cacheFind(key);
+    if (entry)
+    {
+        iResult = entry->address;
+        iState = LOOKUP_DONE;
         return 1;
     }
+#endif
 
     // Check we've got a valid DNS server to use
     if (iDNSServer == INADDR_NONE)
     {
         return INVALID_SERVER;
     }
-	
+
     // Find a socket to use
-    if (iUdp.begin(1024+(millis() & 0xF)) == 1)
+    if (iUdp.begin(1024+(millis() & 0xF)) != 1)
+    {
+        return 0;
+    }
+
+    iTries = 0;
+    int ret = SendRequest();
+    if (ret != 1)
     {
-        // Try up to three times
-        int retries = 0;
-//        while ((retries < 3) && (ret <= 0))
+        iUdp.stop();
+        return ret;
+    }
+    iState = LOOKUP_WAITING;
+    return 1;
+}
+
+int DNSClient::pollHostByName(IPAddress& aResult)
+{
+    int ret;
+
+    if (iState == LOOKUP_DONE)
+    {
+        aResult = iResult;
+        iState = LOOKUP_IDLE;
+        return 1;
+    }
+    if (iState != LOOKUP_WAITING)
+    {
+        return INVALID_RESPONSE;
+    }
+
+    ret = ProcessResponse(0, iResult);
+    if ((ret == TIMED_OUT) || (ret == INVALID_SERVER) || (ret == INVALID_RESPONSE))
+    {
+        // Nothing yet, or a stray packet or a late answer to an earlier try
+        if ((millis() - iSendTime) < DNS_TIMEOUT)
+        {
+            return 0;
+        }
+        ret = TIMED_OUT;
+        if (iTries < DNS_TRIES)
         {
-            // Send DNS request
-            ret = iUdp.beginPacket(iDNSServer, DNS_PORT);
-            if (ret != 0)
+            // Ask again
+            ret = SendRequest();
+            if (ret == 1)
             {
-                // Now output the request data
-                ret = BuildRequest(aHostname);
-                if (ret != 0)
-                {
-                    // And finally send the request
-                    ret = iUdp.endPacket();
-                    if (ret != 0)
-                    {
-                        // Now wait for a response
-                        int wait_retries = 0;
-                        ret = TIMED_OUT;
-                        while ((wait_retries < 3) && (ret == TIMED_OUT))
-                        {
-                            ret = ProcessResponse(5000, aResult);
-                            wait_retries++;
-                        }
-                    }
-                }
+                return 0;
             }
-            retries++;
         }
+    }
 
-        // We're done with the socket now
-        iUdp.stop();
+    // We're done with the socket now
+    iUdp.stop();
+    iState = LOOKUP_IDLE;
+    if (ret == SUCCESS)
+    {
+#if DNS_CACHE_SIZE
+        cacheStore(iHostname, iResult, iTTL);
+#endif
+        aResult = iResult;
     }
+    return ret;
+}
 
+int DNSClient::SendRequest()
+{
+    // Send DNS request
+    int ret = iUdp.beginPacket(iDNSServer, DNS_PORT);
+    if (ret != 0)
+    {
+        // Now output the request data
+        ret = BuildRequest(iHostname);
+        if (ret != 0)
+        {
+            // And finally send the request
+            ret = iUdp.endPacket();
+        }
+    }
+    iSendTime = millis();
+    iTries++;
     return ret;
 }
 
@@ -252,14 +449,14 @@ uint16_t DNSClient::BuildRequest(const char* aName)
 }
 
 
-uint16_t DNSClient::ProcessResponse(uint16_t aTimeout, IPAddress& aAddress)
+int16_t DNSClient::ProcessResponse(uint16_t aTimeout, IPAddress& aAddress)
 {
     uint32_t startTime = millis();
 
     // Wait for a response packet
     while(iUdp.parsePacket() <= 0)
     {
-        if((millis() - startTime) > aTimeout)
+        if((millis() - startTime) >= aTimeout)
             return TIMED_OUT;
         delay(50);
     }
@@ -382,11 +579,9 @@ uint16_t DNSClient::ProcessResponse(uint16_t aTimeout, IPAddress& aAddress)
         iUdp.read((uint8_t*)&answerType, sizeof(answerType));
         iUdp.read((uint8_t*)&answerClass, sizeof(answerClass));
 
-        // Ignore the Time-To-Live as we don't do any caching
-        for (int i =0; i < TTL_SIZE; i++)
-        {
-            iUdp.read(); // we don't care about the returned byte
-        }
+        // Read the Time-To-Live, how long the answer may be cached
+        uint32_t ttl;
+        iUdp.read((uint8_t*)&ttl, TTL_SIZE);
 
         // And read out the length of this answer
         // Don't need header_flags anymore, so we can reuse it here
@@ -402,6 +597,7 @@ uint16_t DNSClient::ProcessResponse(uint16_t aTimeout, IPAddress& aAddress)
                 return -9;//INVALID_RESPONSE;
             }
             iUdp.read(aAddress.raw_address(), 4);
+            iTTL = ntohl(ttl);
             return SUCCESS;
         }
         else
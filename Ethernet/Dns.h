@@ -7,6 +7,16 @@
 
 #include <EthernetUdp.h>
 
+// Number of answers remembered, each for its time-to-live, by all DNSClients.
+// 0 turns the cache off.
+#ifndef DNS_CACHE_SIZE
+#define DNS_CACHE_SIZE 4
+#endif
+// Longest time an answer is kept, in seconds.  Must be well under 24 days.
+#ifndef DNS_CACHE_MAX_TTL
+#define DNS_CACHE_MAX_TTL 86400UL
+#endif
+
 class DNSClient
 {
 public:
@@ -29,13 +39,41 @@ public:
     */
     int getHostByName(const char* aHostname, IPAddress& aResult);
 
+    /** Start resolving the given hostname without waiting for the answer.
+        Numeric addresses and names in the cache are resolved at once.
+        aHostname must stay valid until pollHostByName() has finished.
+        @param aHostname Name to be resolved
+        @result 1 if the request was sent or the name resolved, else error code
+    */
+    int beginHostByName(const char* aHostname);
+
+    /** Check for the answer to the request made by beginHostByName(),
+        without waiting.  The request is sent again after each timeout.
+        @param aResult IPAddress structure to store the returned IP address
+        @result 1 if the name was resolved, 0 while waiting for the answer,
+                else error code
+    */
+    int pollHostByName(IPAddress& aResult);
+
+    /** Forget all the answers in the cache, e.g. after a change of DNS server.
+    */
+    static void clearCache();
+
 protected:
     uint16_t BuildRequest(const char* aName);
-    uint16_t ProcessResponse(uint16_t aTimeout, IPAddress& aAddress);
+    int16_t ProcessResponse(uint16_t aTimeout, IPAddress& aAddress);
+    int SendRequest();
 
     IPAddress iDNSServer;
     uint16_t iRequestId;
     EthernetUDP iUdp;
+    // State of the lookup started by beginHostByName
+    const char* iHostname;
+    IPAddress iResult;
+    uint32_t iTTL;
+    unsigned long iSendTime;
+    uint8_t iTries;
+    uint8_t iState;
 };
 
 #endif
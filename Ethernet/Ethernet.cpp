@@ -6,9 +6,10 @@
 uint8_t  EthernetClass::_state[MAX_SOCK_NUM]       = { 0, 0, 0, 0 } ;
 uint16_t EthernetClass::_server_port[MAX_SOCK_NUM] = { 0, 0, 0, 0 } ;
 
+static DhcpClass s_dhcp;
+
 int EthernetClass::begin (uint8_t * mac_address)
 {
-  static DhcpClass s_dhcp;
   _dhcp = &s_dhcp;
 
 
@@ -32,6 +33,24 @@ int EthernetClass::begin (uint8_t * mac_address)
   return ret;
 }
 
+void EthernetClass::startDHCP(uint8_t *mac_address)
+{
+  _dhcp = &s_dhcp;
+
+  // Initialise the basic info
+  W5100.init();
+  W5100.setMACAddress(mac_address);
+  W5100.setIPAddress(IPAddress(0,0,0,0).raw_address());
+
+  // maintain() carries on from here
+  _dhcp->startDHCP(mac_address);
+}
+
+void EthernetClass::setLeaseCache(int address)
+{
+  s_dhcp.setLeaseCache(address);
+}
+
 void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip)
 {
   // Assume the DNS server will be the machine on the same network as the local IP
@@ -77,6 +96,7 @@ int EthernetClass::maintain(){
         break;
       case DHCP_CHECK_RENEW_OK:
       case DHCP_CHECK_REBIND_OK:
+      case DHCP_CHECK_LEASE_OK:
         //we might have got a new IP.
         W5100.setIPAddress(_dhcp->getLocalIp().raw_address());
         W5100.setGatewayIp(_dhcp->getGatewayIp().raw_address());
@@ -91,6 +111,11 @@ int EthernetClass::maintain(){
   return rc;
 }
 
+unsigned long EthernetClass::dhcpTimeToLease()
+{
+  return _dhcp != NULL ? _dhcp->getTimeToLease() : 0;
+}
+
 IPAddress EthernetClass::localIP()
 {
   IPAddress ret;
@@ -21,11 +21,20 @@ public:
   // configuration through DHCP.
   // Returns 0 if the DHCP configuration failed, and 1 if it succeeded
   int begin(uint8_t *mac_address);
+  // Start getting the configuration through DHCP without waiting for it.  Call maintain()
+  // from loop(), it returns DHCP_CHECK_LEASE_OK once the configuration is set.
+  void startDHCP(uint8_t *mac_address);
+  // Keep the last DHCP lease in EEPROM from address on (sizeof(DHCP_LEASE_CACHE) bytes),
+  // so that after a reset the same address is asked for without a DISCOVER.  Call before
+  // begin() or startDHCP().  Off unless called.
+  void setLeaseCache(int address);
   void begin(uint8_t *mac_address, IPAddress local_ip);
   void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server);
   void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway);
   void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet);
   int maintain();
+  // Milliseconds the last DHCP exchange took to get its lease
+  unsigned long dhcpTimeToLease();
 
   IPAddress localIP();
   IPAddress subnetMask();
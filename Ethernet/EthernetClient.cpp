@@ -14,6 +14,17 @@ extern "C" {
 
 uint16_t EthernetClient::_srcport = 1024;
 
+#if ETHERNET_RX_BUFFER_SIZE
+// Read ahead data, per socket because clients are copied by value
+static uint8_t rxBuffer[MAX_SOCK_NUM][ETHERNET_RX_BUFFER_SIZE];
+static uint8_t rxHead[MAX_SOCK_NUM];
+static uint8_t rxCount[MAX_SOCK_NUM];
+#endif
+
+// Output batching, per socket for the same reason
+static uint16_t txDelay[MAX_SOCK_NUM];
+static uint16_t txStart[MAX_SOCK_NUM];
+
 EthernetClient::EthernetClient() : _sock(MAX_SOCK_NUM) { }
 
 EthernetClient::EthernetClient(uint8_t sock) : _sock(sock) { }
@@ -40,6 +51,8 @@ int EthernetClient::connect(IPAddress ip, uint16_t port)
     return 0;
 
   for (int i = 0; i < MAX_SOCK_NUM; i++) {
+    if (!W5100.getTXMaxSize(i) || !W5100.getRXMaxSize(i))
+      continue; // socket has no buffer memory
     uint8_t s = W5100.readSnSR(i);
     if (s == SnSR::CLOSED || s == SnSR::FIN_WAIT || s == SnSR::CLOSE_WAIT) {
       _sock = i;
@@ -53,6 +66,7 @@ int EthernetClient::connect(IPAddress ip, uint16_t port)
   _srcport++;
   if (_srcport == 0) _srcport = 1024;
   socket(_sock, SnMR::TCP, _srcport, 0);
+  clearBuffers(_sock);
 
   if (!::connect(_sock, rawIPAddress(ip), port)) {
     _sock = MAX_SOCK_NUM;
@@ -81,22 +95,117 @@ size_t EthernetClient::write(const uint8_t *buf, size_t size)
     setWriteError();
     return 0;
   }
-  if (!send(_sock, buf, size)) {
-    setWriteError();
-    return 0;
+  if (!txDelay[_sock]) {
+    if (!send(_sock, buf, size)) {
+      setWriteError();
+      return 0;
+    }
+    return size;
   }
-  return size;
+
+  // queue in the chip's Tx buffer, a SEND goes out for each full segment
+  size_t n = 0;
+  while (n < size) {
+    uint16_t pending = sendPending(_sock);
+    uint16_t len = ETHERNET_TX_SEGMENT - pending;
+    if (len > size - n)
+      len = size - n;
+    len = sendQueue(_sock, buf + n, len);
+    if (len && !pending)
+      txStart[_sock] = millis();
+    n += len;
+    if (sendPending(_sock) >= ETHERNET_TX_SEGMENT || (!len && pending)) {
+      sendFlush(_sock);
+    } else if (!len) {
+      // buffer full, wait for the peer unless the connection is gone
+      uint8_t s = status();
+      if (s != SnSR::ESTABLISHED && s != SnSR::CLOSE_WAIT) {
+        setWriteError();
+        return n;
+      }
+    }
+  }
+  sendIfDue();
+  return n;
+}
+
+/**
+ * Set how long output may wait in the chip before it is sent.  With a
+ * delay, writes are batched into one SEND command and one packet per
+ * segment, sent when a segment is full, when flush() or stop() is
+ * called, or when the oldest byte is ms old.  The delay is checked by
+ * write(), available() and connected() and, for clients of a server, by
+ * EthernetServer::available().  0, the default, sends each write at once.
+ * Either way write() returns once the SEND command is issued and doesn't
+ * wait for the chip to finish it; the next SEND waits instead, and a
+ * connection lost meanwhile shows as a failed write() or connected().
+ * The setting lasts until the socket is opened again.
+ */
+void EthernetClient::setSendDelay(uint16_t ms)
+{
+  if (_sock == MAX_SOCK_NUM)
+    return;
+  txDelay[_sock] = ms;
+  if (!ms)
+    sendFlush(_sock);
+}
+
+// Send batched output once the send delay has passed
+void EthernetClient::sendIfDue()
+{
+  if (txDelay[_sock] && sendPending(_sock) &&
+      (uint16_t)((uint16_t)millis() - txStart[_sock]) >= txDelay[_sock])
+    sendFlush(_sock);
 }
 
 int EthernetClient::available()
 {
-  if (_sock != MAX_SOCK_NUM)
+  if (_sock != MAX_SOCK_NUM) {
+    sendIfDue();
+#if ETHERNET_RX_BUFFER_SIZE
+    // bytes already read ahead plus those still in the chip
+    return rxCount[_sock] + W5100.getRXReceivedSize(_sock);
+#else
     return W5100.getRXReceivedSize(_sock);
+#endif
+  }
   return 0;
 }
 
+#if ETHERNET_RX_BUFFER_SIZE
+// Refill the read ahead buffer with one recv.  Returns the number of bytes
+// buffered, or recv's result if there are none.
+int EthernetClient::fillRxBuffer()
+{
+  if (rxCount[_sock])
+    return rxCount[_sock];
+  int ret = recv(_sock, rxBuffer[_sock], ETHERNET_RX_BUFFER_SIZE);
+  rxHead[_sock] = 0;
+  if (ret > 0)
+    rxCount[_sock] = ret;
+  return ret;
+}
+#endif
+
+void EthernetClient::clearBuffers(uint8_t sock)
+{
+  txDelay[sock] = 0;
+#if ETHERNET_RX_BUFFER_SIZE
+  rxHead[sock] = 0;
+  rxCount[sock] = 0;
+#endif
+}
+
 int EthernetClient::read()
 {
+  if (_sock == MAX_SOCK_NUM)
+    return -1;
+#if ETHERNET_RX_BUFFER_SIZE
+  if (fillRxBuffer() <= 0)
+    return -1;
+  rxCount[_sock]--;
+  return rxBuffer[_sock][rxHead[_sock]++];
+#else
   uint8_t b;
   if ( recv(_sock, &b, 1) > 0 )
   {
@@ -108,25 +217,98 @@ int EthernetClient::read()
     // No data available
     return -1;
   }
+#endif
 }
 
 int EthernetClient::read(uint8_t *buf, size_t size)
 {
+#if ETHERNET_RX_BUFFER_SIZE
+  if (_sock != MAX_SOCK_NUM && rxCount[_sock]) {
+    // hand out buffered bytes first, the next call reads the chip directly
+    if (size > rxCount[_sock])
+      size = rxCount[_sock];
+    memcpy(buf, rxBuffer[_sock] + rxHead[_sock], size);
+    rxHead[_sock] += size;
+    rxCount[_sock] -= size;
+    return size;
+  }
+#endif
   return recv(_sock, buf, size);
 }
 
+/**
+ * Pass received data to fn without keeping a copy.  Buffered bytes are
+ * passed first, then each contiguous span of the chip's receive ring is
+ * read into buf, at most size bytes at a time.  Only the bytes fn uses are
+ * removed, with one RX_RD update and one RECV command for the whole call.
+ * A count larger than fn was given is taken as all of them.  Returns the
+ * number of bytes used.
+ */
+int EthernetClient::read(uint8_t *buf, size_t size, EthernetReadCallback fn, void *arg)
+{
+  size_t used = 0;
+
+  if (_sock == MAX_SOCK_NUM || size == 0)
+    return 0;
+#if ETHERNET_RX_BUFFER_SIZE
+  if (rxCount[_sock]) {
+    used = fn(rxBuffer[_sock] + rxHead[_sock], rxCount[_sock], arg);
+    if (used > rxCount[_sock]) used = rxCount[_sock];
+    rxHead[_sock] += used;
+    rxCount[_sock] -= used;
+    if (rxCount[_sock])
+      return used;
+  }
+#endif
+  uint16_t avail = W5100.getRXReceivedSize(_sock);
+  if (avail == 0)
+    return used;
+
+  uint16_t ptr = W5100.readSnRX_RD(_sock);
+  uint16_t ringSize = W5100.getRXMaxSize(_sock);
+  uint16_t taken = 0;
+  while (avail) {
+    // stop at the end of the ring so each span is contiguous
+    uint16_t n = ringSize - (ptr & (ringSize - 1));
+    if (n > avail) n = avail;
+    if (n > size) n = size;
+    W5100.read_data(_sock, (uint8_t *)ptr, buf, n);
+    size_t u = fn(buf, n, arg);
+    // the bytes fn didn't use stay in the chip for the next read
+    if (u > n) u = n;
+    ptr += u;
+    avail -= u;
+    taken += u;
+    if (u < n)
+      break;
+  }
+  if (taken) {
+    W5100.writeSnRX_RD(_sock, ptr);
+    W5100.execCmdSn(_sock, Sock_RECV);
+  }
+  return used + taken;
+}
+
 int EthernetClient::peek()
 {
+#if ETHERNET_RX_BUFFER_SIZE
+  if (_sock == MAX_SOCK_NUM || fillRxBuffer() <= 0)
+    return -1;
+  return rxBuffer[_sock][rxHead[_sock]];
+#else
   uint8_t b;
   // Unlike recv, peek doesn't check to see if there's any data available, so we must
   if (!available())
     return -1;
   ::peek(_sock, &b);
   return b;
+#endif
 }
 
 void EthernetClient::flush()
 {
+  if (_sock != MAX_SOCK_NUM)
+    sendFlush(_sock);
   while (available())
     read();
 }
@@ -136,9 +318,15 @@ void EthernetClient::stop()
   if (_sock == MAX_SOCK_NUM)
     return;
 
+  unsigned long start = millis();
+
+  // send what is batched and let the chip finish it
+  sendFlush(_sock);
+  while (!sendDone(_sock) && millis() - start < 1000)
+    delay(1);
+
   // attempt to close the connection gracefully (send a FIN to other side)
   disconnect(_sock);
-  unsigned long start = millis();
 
   // wait a second for the connection to close
   while (status() != SnSR::CLOSED && millis() - start < 1000)
@@ -149,12 +337,14 @@ void EthernetClient::stop()
     close(_sock);
 
   EthernetClass::_server_port[_sock] = 0;
+  clearBuffers(_sock);
   _sock = MAX_SOCK_NUM;
 }
 
 uint8_t EthernetClient::connected()
 {
   if (_sock == MAX_SOCK_NUM) return 0;
+  sendIfDue();
   
   uint8_t s = status();
   return !(s == SnSR::LISTEN || s == SnSR::CLOSED || s == SnSR::FIN_WAIT ||
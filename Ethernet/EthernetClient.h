@@ -5,6 +5,28 @@
 #include "Client.h"
 #include "IPAddress.h"
 
+// Bytes read ahead from the chip for each socket, so that read() and peek()
+// don't cost a dozen register accesses per byte.  0 turns the buffer off.
+// The buffers take MAX_SOCK_NUM times this much RAM, so boards with 2 KB
+// leave them off unless this is defined before the library is included.
+#ifndef ETHERNET_RX_BUFFER_SIZE
+#if defined(RAMEND) && RAMEND > 0x8FF
+#define ETHERNET_RX_BUFFER_SIZE 64
+#else
+#define ETHERNET_RX_BUFFER_SIZE 0
+#endif
+#endif
+
+// Bytes of output batched into one SEND when a send delay is set, a full
+// segment at the chip's default MSS.
+#ifndef ETHERNET_TX_SEGMENT
+#define ETHERNET_TX_SEGMENT 1460
+#endif
+
+// Called by EthernetClient::read(buf, size, fn, arg) with received data.
+// Returns the number of bytes used, the rest is passed again next time.
+typedef size_t (*EthernetReadCallback)(const uint8_t *data, size_t len, void *arg);
+
 class EthernetClient : public Client {
 
 public:
@@ -19,19 +41,25 @@ public:
   virtual int available();
   virtual int read();
   virtual int read(uint8_t *buf, size_t size);
+  int read(uint8_t *buf, size_t size, EthernetReadCallback fn, void *arg);
   virtual int peek();
   virtual void flush();
   virtual void stop();
+  void setSendDelay(uint16_t ms);
   virtual uint8_t connected();
   virtual operator bool();
 
   friend class EthernetServer;
+  friend class HttpServer;
   
   using Print::write;
 
 private:
   static uint16_t _srcport;
   uint8_t _sock;
+  int fillRxBuffer();
+  static void clearBuffers(uint8_t sock);
+  void sendIfDue();
 };
 
 #endif
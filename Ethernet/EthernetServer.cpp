@@ -8,20 +8,71 @@ extern "C" {
 #include "EthernetClient.h"
 #include "EthernetServer.h"
 
-EthernetServer::EthernetServer(uint16_t port)
+// When each socket was last listening, had data waiting or sent some, for the
+// idle timeout
+static unsigned long lastActive[MAX_SOCK_NUM];
+static uint8_t closing;  // bit per idle socket disconnected by accept()
+
+EthernetServer::EthernetServer(uint16_t port, uint8_t backlog)
 {
   _port = port;
+  _backlog = backlog ? backlog : 1;
+  _next = 0;
+  _timeout = 0;
+  _busy = 0;
+}
+
+// Connections that have sent nothing for ms, and been sent nothing, are closed
+// and their sockets listen again.  0, the default, leaves them open.
+void EthernetServer::setIdleTimeout(unsigned long ms)
+{
+  _timeout = ms;
+}
+
+// A busy connection is one the sketch is still answering, and the idle
+// timeout leaves it open however long that takes.
+void EthernetServer::setBusy(uint8_t sock, bool busy)
+{
+  if (busy)
+    _busy |= 1 << sock;
+  else
+    _busy &= ~(1 << sock);
 }
 
+// Opens listening sockets on the port until there are as many as the backlog.
+// The chip takes one connection per listening socket, so more of them keep a
+// burst of clients from being refused while the sketch serves the first.
+// Only the first may take the last closed socket; the others leave it for
+// clients and UDP, such as DHCP and DNS.
 void EthernetServer::begin()
 {
+  int listening = 0;
+  int closed = 0;
+
   for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
+    uint8_t status = W5100.readSnSR(sock);
+    if (EthernetClass::_server_port[sock] == _port && status == SnSR::LISTEN)
+      listening++;
+    else if (status == SnSR::CLOSED && W5100.getTXMaxSize(sock) &&
+             W5100.getRXMaxSize(sock))
+      closed++;
+  }
+
+  for (int sock = 0; sock < MAX_SOCK_NUM && listening < _backlog; sock++) {
+    if (!W5100.getTXMaxSize(sock) || !W5100.getRXMaxSize(sock))
+      continue; // socket has no buffer memory
     EthernetClient client(sock);
     if (client.status() == SnSR::CLOSED) {
+      if (listening && closed <= 1)
+        break;
+      closed--;
       socket(sock, SnMR::TCP, _port, 0);
+      EthernetClient::clearBuffers(sock);
       listen(sock);
       EthernetClass::_server_port[sock] = _port;
-      break;
+      lastActive[sock] = millis();
+      closing &= ~(1 << sock);
+      listening++;
     }
   }  
 }
@@ -29,21 +80,45 @@ void EthernetServer::begin()
 void EthernetServer::accept()
 {
   int listening = 0;
+  unsigned long now = millis();
 
   for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
     EthernetClient client(sock);
 
     if (EthernetClass::_server_port[sock] == _port) {
-      if (client.status() == SnSR::LISTEN) {
-        listening = 1;
+      client.sendIfDue();
+      uint8_t status = client.status();
+      if (status == SnSR::LISTEN) {
+        listening++;
+        lastActive[sock] = now;
       } 
-      else if (client.status() == SnSR::CLOSE_WAIT && !client.available()) {
+      else if (status == SnSR::CLOSE_WAIT && !client.available()) {
         client.stop();
       }
+      else if (status == SnSR::ESTABLISHED || status == SnSR::CLOSE_WAIT) {
+        if (sendProgress(sock) || client.available() || (_busy & (1 << sock)))
+          lastActive[sock] = now;
+        else if (_timeout && now - lastActive[sock] >= _timeout) {
+          // idle, ask the peer to close without waiting for it
+          disconnect(sock);
+          EthernetClient::clearBuffers(sock);
+          lastActive[sock] = now;
+          closing |= 1 << sock;
+        }
+      }
+      else if (closing & (1 << sock)) {
+        if (status == SnSR::CLOSED)
+          closing &= ~(1 << sock);
+        else if (now - lastActive[sock] >= 1000) {
+          // the peer didn't answer the FIN
+          close(sock);
+          closing &= ~(1 << sock);
+        }
+      }
     } 
   }
 
-  if (!listening) {
+  if (listening < _backlog) {
     begin();
   }
 }
@@ -52,13 +127,15 @@ EthernetClient EthernetServer::available()
 {
   accept();
 
-  for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
+  // start after the socket returned last time, so that every client is served
+  for (int i = 0; i < MAX_SOCK_NUM; i++) {
+    uint8_t sock = (_next + i) % MAX_SOCK_NUM;
     EthernetClient client(sock);
     if (EthernetClass::_server_port[sock] == _port &&
         (client.status() == SnSR::ESTABLISHED ||
          client.status() == SnSR::CLOSE_WAIT)) {
       if (client.available()) {
-        // XXX: don't always pick the lowest numbered socket.
+        _next = sock + 1;
         return client;
       }
     }
@@ -9,11 +9,17 @@ class EthernetServer :
 public Server {
 private:
   uint16_t _port;
+  uint8_t _backlog;        // sockets kept listening
+  uint8_t _next;           // socket available() looks at first
+  unsigned long _timeout;  // idle time before a connection is closed, 0 for never
+  uint8_t _busy;           // bit per socket kept open however idle
   void accept();
 public:
-  EthernetServer(uint16_t);
+  EthernetServer(uint16_t, uint8_t backlog = 1);
   EthernetClient available();
   virtual void begin();
+  void setIdleTimeout(unsigned long ms);
+  void setBusy(uint8_t sock, bool busy);
   virtual size_t write(uint8_t);
   virtual size_t write(const uint8_t *buf, size_t size);
   using Print::write;
@@ -41,6 +41,8 @@ uint8_t EthernetUDP::begin(uint16_t port) {
     return 0;
 
   for (int i = 0; i < MAX_SOCK_NUM; i++) {
+    if (!W5100.getTXMaxSize(i) || !W5100.getRXMaxSize(i))
+      continue; // socket has no buffer memory
     uint8_t s = W5100.readSnSR(i);
     if (s == SnSR::CLOSED || s == SnSR::FIN_WAIT) {
       _sock = i;
@@ -206,13 +208,61 @@ int EthernetUDP::peek()
 
 void EthernetUDP::flush()
 {
-  // could this fail (loop endlessly) if _remaining > 0 and recv in read fails?
-  // should only occur if recv fails after telling us the data is there, lets
-  // hope the w5100 always behaves :)
+  // skip the rest of the packet without reading it
+  if (_remaining)
+  {
+    W5100.writeSnRX_RD(_sock, W5100.readSnRX_RD(_sock) + _remaining);
+    W5100.execCmdSn(_sock, Sock_RECV);
+    _remaining = 0;
+  }
+}
+
+int EthernetUDP::sendPacket(IPAddress ip, uint16_t port, const uint8_t *buffer, size_t size)
+{
+  return ::sendPacket(_sock, buffer, size, rawIPAddress(ip), port);
+}
 
-  while (_remaining)
+int EthernetUDP::receivePacket(uint8_t *buffer, size_t size)
+{
+  // discard any remaining bytes in the last packet
+  flush();
+
+  if (size > 0xFFFF)
+    size = 0xFFFF;
+  if (recvPackets(_sock, buffer, size, 1) == 0)
+    return -1;
+
+  _remoteIP = buffer;
+  _remotePort = buffer[4];
+  _remotePort = (_remotePort << 8) + buffer[5];
+  return (buffer[6] << 8) + buffer[7];
+}
+
+int EthernetUDP::parsePackets(uint8_t *buffer, size_t size, UDPPacketHandler fn, void *arg)
+{
+  uint16_t got, pos, len;
+  int packets = 0;
+
+  // discard any remaining bytes in the last packet
+  flush();
+
+  if (size > 0xFFFF)
+    size = 0xFFFF;
+  while ((got = recvPackets(_sock, buffer, size, 0xFF)) > 0)
   {
-    read();
+    // the headers are read where they are in buffer
+    for (pos = 0; pos < got; pos += UDP_HEADER_SIZE + len)
+    {
+      uint8_t *head = buffer + pos;
+      _remoteIP = head;
+      _remotePort = head[4];
+      _remotePort = (_remotePort << 8) + head[5];
+      len = head[6];
+      len = (len << 8) + head[7];
+      fn(_remoteIP, _remotePort, head + UDP_HEADER_SIZE, len, arg);
+      packets++;
+    }
   }
+  return packets;
 }
 
@@ -40,6 +40,10 @@
 #include <Udp.h>
 
 #define UDP_TX_PACKET_MAX_SIZE 24
+#define UDP_HEADER_SIZE 8 // address, port and length the chip puts before each datagram
+
+// Called by parsePackets for each datagram, data points into the caller's buffer
+typedef void (*UDPPacketHandler)(IPAddress ip, uint16_t port, uint8_t *data, uint16_t len, void *arg);
 
 class EthernetUDP : public UDP {
 private:
@@ -90,6 +94,20 @@ public:
   virtual int peek();
   virtual void flush();	// Finish reading the current packet
 
+  // Whole packets, each moved with one access to the chip's buffer
+
+  // Send size bytes from buffer as one packet.  Doesn't wait for it to go out
+  // Returns the number of bytes sent, 0 if there was an error
+  int sendPacket(IPAddress ip, uint16_t port, const uint8_t *buffer, size_t size);
+  // Receive the next packet into buffer, its UDP_HEADER_SIZE byte header first and the
+  // data behind it.  A packet too big for buffer is cut short
+  // Returns the size of the data, or -1 if no packets are available
+  int receivePacket(uint8_t *buffer, size_t size);
+  // Receive all the packets waiting, as many at a time as fit in buffer, and call fn
+  // with each one.  buffer should have room for UDP_HEADER_SIZE more than the biggest
+  // Returns the number of packets received
+  int parsePackets(uint8_t *buffer, size_t size, UDPPacketHandler fn, void *arg = NULL);
+
   // Return the IP address of the host who sent the current incoming packet
   virtual IPAddress remoteIP() { return _remoteIP; };
   // Return the port of the host who sent the current incoming packet
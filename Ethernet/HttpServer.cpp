@@ -0,0 +1,444 @@
+#include "w5100.h"
+#include "socket.h"
+extern "C" {
+#include "string.h"
+#include "stdlib.h"
+#include "ctype.h"
+}
+
+#include "Ethernet.h"
+#include "HttpServer.h"
+
+// Where the parser is in a request
+#define HTTP_IDLE    0  // waiting for the request line
+#define HTTP_METHOD  1
+#define HTTP_PATH    2
+#define HTTP_VERSION 3
+#define HTTP_NAME    4  // header name, or the blank line ending the headers
+#define HTTP_VALUE   5
+#define HTTP_READY   6  // handed to the sketch until end()
+#define HTTP_ERROR   7
+
+// Headers the parser looks at
+#define HEADER_OTHER             0
+#define HEADER_CONTENT_LENGTH    1
+#define HEADER_CONNECTION        2
+#define HEADER_TRANSFER_ENCODING 3
+
+uint8_t HttpRequest::_fileBlock[HTTP_FILE_BLOCK];
+const uint16_t HttpRequest::_fileBlockSize = HTTP_FILE_BLOCK;
+
+static const char *reason(int status)
+{
+  switch (status) {
+  case 200: return "OK";
+  case 201: return "Created";
+  case 204: return "No Content";
+  case 301: return "Moved Permanently";
+  case 302: return "Found";
+  case 304: return "Not Modified";
+  case 400: return "Bad Request";
+  case 403: return "Forbidden";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 411: return "Length Required";
+  case 413: return "Payload Too Large";
+  case 414: return "URI Too Long";
+  case 501: return "Not Implemented";
+  case 503: return "Service Unavailable";
+  }
+  return status < 500 ? "Error" : "Server Error";
+}
+
+void HttpRequest::reset()
+{
+  _state = HTTP_IDLE;
+  _len = 0;
+  _http11 = false;
+  _keepAlive = false;
+  _chunked = false;
+  _inChunk = false;
+  _noBody = false;
+  _contentLength = 0;
+  _method[0] = 0;
+  _path[0] = 0;
+}
+
+size_t HttpRequest::parseCallback(const uint8_t *data, size_t len, void *arg)
+{
+  return ((HttpRequest *)arg)->parse(data, len);
+}
+
+// Takes the request a piece at a time, as it arrives.  Stops after the
+// blank line ending the headers, leaving the body to read().
+size_t HttpRequest::parse(const uint8_t *data, size_t len)
+{
+  size_t i = 0;
+
+  while (i < len && _state != HTTP_READY && _state != HTTP_ERROR) {
+    if (_state == HTTP_IDLE && _bodyLeft > 0) {
+      // the part of the last request's body that wasn't read
+      size_t n = len - i;
+      if ((long)n > _bodyLeft)
+        n = _bodyLeft;
+      _bodyLeft -= n;
+      i += n;
+      continue;
+    }
+
+    char c = data[i++];
+    switch (_state) {
+    case HTTP_IDLE:
+      if (c == '\r' || c == '\n')
+        break;
+      _state = HTTP_METHOD;
+      // fall through
+    case HTTP_METHOD:
+      if (c == ' ') {
+        _state = HTTP_PATH;
+        _len = 0;
+      } else if (_len < sizeof(_method) - 1) {
+        _method[_len++] = c;
+        _method[_len] = 0;
+      } else {
+        _error = 501;
+        _state = HTTP_ERROR;
+      }
+      break;
+    case HTTP_PATH:
+      if (c == ' ') {
+        _path[_len] = 0;
+        _state = HTTP_VERSION;
+        _len = 0;
+      } else if (c == '\r' || c == '\n') {
+        _error = 400;
+        _state = HTTP_ERROR;
+      } else if (_len < sizeof(_path) - 1) {
+        _path[_len++] = c;
+      } else {
+        _error = 414;
+        _state = HTTP_ERROR;
+      }
+      break;
+    case HTTP_VERSION:
+      if (c == '\n') {
+        _token[_len] = 0;
+        if (strncmp(_token, "HTTP/1.", 7)) {
+          _error = 400;
+          _state = HTTP_ERROR;
+          break;
+        }
+        // connections persist by default from HTTP/1.1
+        _http11 = _token[7] != '0';
+        _keepAlive = _http11;
+        _state = HTTP_NAME;
+        _len = 0;
+      } else if (c != '\r' && _len < sizeof(_token) - 1) {
+        _token[_len++] = c;
+      }
+      break;
+    case HTTP_NAME:
+      if (c == '\n') {
+        if (_len == 0) {
+          _bodyLeft = _contentLength;
+          _state = HTTP_READY;
+        }
+        _len = 0;
+      } else if (c == ':') {
+        _token[_len] = 0;
+        if (!strcmp(_token, "content-length"))
+          _header = HEADER_CONTENT_LENGTH;
+        else if (!strcmp(_token, "connection"))
+          _header = HEADER_CONNECTION;
+        else if (!strcmp(_token, "transfer-encoding"))
+          _header = HEADER_TRANSFER_ENCODING;
+        else
+          _header = HEADER_OTHER;
+        _state = HTTP_VALUE;
+        _len = 0;
+      } else if (c != '\r' && _len < sizeof(_token) - 1) {
+        _token[_len++] = tolower(c);
+      }
+      break;
+    case HTTP_VALUE:
+      if (c == '\n') {
+        _token[_len] = 0;
+        endHeader();
+        if (_state == HTTP_VALUE)
+          _state = HTTP_NAME;
+        _len = 0;
+      } else if ((c == ' ' || c == '\t') && _len == 0) {
+        // leading white space
+      } else if (c != '\r' && _len < sizeof(_token) - 1) {
+        _token[_len++] = tolower(c);
+      }
+      break;
+    }
+  }
+  return i;
+}
+
+void HttpRequest::endHeader()
+{
+  switch (_header) {
+  case HEADER_CONTENT_LENGTH:
+    _contentLength = atol(_token);
+    if (_contentLength < 0) {
+      _error = 400;
+      _state = HTTP_ERROR;
+    }
+    break;
+  case HEADER_CONNECTION:
+    if (strstr(_token, "close"))
+      _keepAlive = false;
+    else if (strstr(_token, "keep-alive"))
+      _keepAlive = true;
+    break;
+  case HEADER_TRANSFER_ENCODING:
+    // a chunked body would have to be decoded, ask for its length instead
+    _error = 411;
+    _state = HTTP_ERROR;
+    break;
+  }
+}
+
+int HttpRequest::available()
+{
+  EthernetClient client(_sock);
+  int n = client.available();
+  return n < _bodyLeft ? n : _bodyLeft;
+}
+
+int HttpRequest::read()
+{
+  if (_bodyLeft <= 0)
+    return -1;
+  EthernetClient client(_sock);
+  int b = client.read();
+  if (b >= 0)
+    _bodyLeft--;
+  return b;
+}
+
+int HttpRequest::read(uint8_t *buf, size_t size)
+{
+  if (_bodyLeft <= 0)
+    return -1;
+  if ((long)size > _bodyLeft)
+    size = _bodyLeft;
+  EthernetClient client(_sock);
+  int n = client.read(buf, size);
+  if (n > 0)
+    _bodyLeft -= n;
+  return n;
+}
+
+void HttpRequest::beginResponse(int status, const char *contentType, long length)
+{
+  print("HTTP/1.1 ");
+  print(status);
+  print(' ');
+  print(reason(status));
+  print("\r\n");
+  if (contentType) {
+    print("Content-Type: ");
+    print(contentType);
+    print("\r\n");
+  }
+  if (length >= 0) {
+    print("Content-Length: ");
+    print(length);
+    print("\r\n");
+  } else if (_http11) {
+    print("Transfer-Encoding: chunked\r\n");
+  } else {
+    // the end of the body is the end of the connection
+    _keepAlive = false;
+  }
+  if (!_keepAlive)
+    print("Connection: close\r\n");
+  else if (!_http11)
+    print("Connection: keep-alive\r\n");
+  print("\r\n");
+
+  _chunked = length < 0 && _http11;
+  _room = 0;
+  _noBody = !strcmp(_method, "HEAD");
+}
+
+size_t HttpRequest::write(uint8_t b)
+{
+  return write(&b, 1);
+}
+
+// Copies the body into the Tx buffer.  Chunks are as big as the room in
+// the buffer, each size line written as 0000 and filled in when the chunk
+// ends, so no copy of the data is kept.
+size_t HttpRequest::write(const uint8_t *buf, size_t size)
+{
+  size_t n = 0;
+
+  if (_noBody)
+    return size;
+  if (!_chunked)
+    return queue(buf, size);
+
+  while (n < size) {
+    // the size line, a byte and the CRLF ending the chunk
+    uint16_t need = _inChunk ? 1 + 2 : 6 + 1 + 2;
+    if (_room < need) {
+      // TX_FSR is only read when the room seen last is used up
+      _room = sendRoom(_sock);
+      if (_room < need) {
+        if (_inChunk)
+          endChunk();
+        if (!makeRoom())
+          break;
+        continue;
+      }
+    }
+    if (!_inChunk) {
+      _chunkAt = sendPending(_sock);
+      sendQueue(_sock, (const uint8_t *)"0000\r\n", 6);
+      _inChunk = true;
+      _chunkLen = 0;
+      _room -= 6;
+    }
+    uint16_t len = _room - 2;
+    if (len > size - n)
+      len = size - n;
+    len = sendQueue(_sock, buf + n, len);
+    if (!len)
+      _room = 0;
+    _chunkLen += len;
+    _room -= len;
+    n += len;
+  }
+  if (n < size)
+    setWriteError();
+  return n;
+}
+
+// Copies data into the Tx buffer as it is, sending and waiting for room
+// when it is full
+size_t HttpRequest::queue(const uint8_t *buf, size_t size)
+{
+  size_t n = 0;
+
+  while (n < size) {
+    uint16_t len = size - n > 0xFFFF ? 0xFFFF : size - n;
+    len = sendQueue(_sock, buf + n, len);
+    n += len;
+    if (!len && !makeRoom()) {
+      setWriteError();
+      break;
+    }
+  }
+  return n;
+}
+
+// Sends what is queued, so that room comes back as the peer acknowledges it.
+// Returns false if the connection is gone.
+bool HttpRequest::makeRoom()
+{
+  if (sendPending(_sock)) {
+    sendFlush(_sock);
+    return true;
+  }
+  uint8_t status = W5100.readSnSR(_sock);
+  return status == SnSR::ESTABLISHED || status == SnSR::CLOSE_WAIT;
+}
+
+void HttpRequest::endChunk()
+{
+  static const char digits[] = "0123456789abcdef";
+  uint8_t hex[4];
+
+  for (uint8_t i = 0; i < 4; i++)
+    hex[i] = digits[(_chunkLen >> (12 - 4 * i)) & 0x0F];
+  sendRewrite(_sock, _chunkAt, hex, 4);
+  sendQueue(_sock, (const uint8_t *)"\r\n", 2);
+  _room -= 2;
+  _inChunk = false;
+}
+
+void HttpRequest::flush()
+{
+  if (_inChunk)
+    endChunk();
+  sendFlush(_sock);
+}
+
+void HttpRequest::end()
+{
+  if (_inChunk)
+    endChunk();
+  if (_chunked && !_noBody)
+    queue((const uint8_t *)"0\r\n\r\n", 5);
+  sendFlush(_sock);
+  if (!_keepAlive) {
+    EthernetClient client(_sock);
+    client.stop();
+    _bodyLeft = 0;
+  }
+  // the rest of the body, if any, is skipped by parse()
+  reset();
+}
+
+void HttpRequest::sendError(int status)
+{
+  const char *text = reason(status);
+
+  beginResponse(status, "text/plain", strlen(text));
+  print(text);
+  end();
+}
+
+HttpServer::HttpServer(uint16_t port, uint8_t backlog) : _server(port, backlog)
+{
+  for (uint8_t i = 0; i < MAX_SOCK_NUM; i++) {
+    _requests[i]._sock = i;
+    _requests[i]._bodyLeft = 0;
+    _requests[i].reset();
+  }
+  _server.setIdleTimeout(HTTP_KEEP_ALIVE_TIMEOUT);
+}
+
+void HttpServer::begin()
+{
+  _server.begin();
+}
+
+HttpRequest *HttpServer::available()
+{
+  uint8_t buf[64];
+
+  // a connection closed part way through a request starts again, and one the
+  // sketch is still answering is not closed for being idle
+  for (uint8_t i = 0; i < MAX_SOCK_NUM; i++) {
+    HttpRequest &req = _requests[i];
+    _server.setBusy(i, req._state == HTTP_READY);
+    if (req._state != HTTP_IDLE || req._bodyLeft) {
+      uint8_t status = W5100.readSnSR(i);
+      if (status != SnSR::ESTABLISHED && status != SnSR::CLOSE_WAIT) {
+        req._bodyLeft = 0;
+        req.reset();
+      }
+    }
+  }
+
+  EthernetClient client = _server.available();
+  if (!client)
+    return NULL;
+  HttpRequest &req = _requests[client._sock];
+  if (req._state == HTTP_READY)
+    return NULL;  // still being answered
+
+  client.read(buf, sizeof(buf), HttpRequest::parseCallback, &req);
+  if (req._state == HTTP_ERROR) {
+    req._keepAlive = false;
+    req.sendError(req._error);
+    return NULL;
+  }
+  return req._state == HTTP_READY ? &req : NULL;
+}
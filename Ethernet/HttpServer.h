@@ -0,0 +1,152 @@
+#ifndef httpserver_h
+#define httpserver_h
+
+#include "Arduino.h"
+#include "Print.h"
+#include "EthernetServer.h"
+#include "EthernetClient.h"
+
+// Longest request path kept, with its query string.  Longer requests get
+// 414 URI Too Long.
+#ifndef HTTP_PATH_SIZE
+#if defined(RAMEND) && RAMEND > 0x8FF
+#define HTTP_PATH_SIZE 64
+#else
+#define HTTP_PATH_SIZE 32
+#endif
+#endif
+
+// Bytes of a file read at a time by HttpRequest::sendFile(), into one buffer
+// shared by all requests.  Smaller reads are copied out of the SD library's
+// block cache; 512, one SD block, lets it read whole blocks straight into the
+// buffer, which is faster but costs the RAM.
+#ifndef HTTP_FILE_BLOCK
+#if defined(RAMEND) && RAMEND > 0x8FF
+#define HTTP_FILE_BLOCK 128
+#else
+#define HTTP_FILE_BLOCK 64
+#endif
+#endif
+
+// How long a kept-alive connection may wait for its next request.
+#ifndef HTTP_KEEP_ALIVE_TIMEOUT
+#define HTTP_KEEP_ALIVE_TIMEOUT 5000
+#endif
+
+// One HTTP/1.1 exchange on one connection.  The request line and headers are
+// parsed as they arrive, without buffering the request.  The body, if any,
+// is read with available() and read().  The response is written straight
+// into the chip's Tx buffer: chunked when its length isn't given and the
+// client speaks HTTP/1.1, with each chunk's size filled in once the chunk
+// is complete.  end() finishes the response and, unless the connection is
+// kept alive, closes it.
+class HttpRequest : public Print {
+public:
+  const char *method() { return _method; }
+  const char *path() { return _path; }
+  long contentLength() { return _contentLength; }
+  bool keepAlive() { return _keepAlive; }
+
+  // Request body
+  int available();
+  int read();
+  int read(uint8_t *buf, size_t size);
+
+  // Status line and headers.  length is the size of the body, or -1 for
+  // a body sent in chunks or, to an HTTP/1.0 client, ended by closing.
+  void beginResponse(int status, const char *contentType, long length = -1);
+  virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *buf, size_t size);
+  using Print::write;
+  // Sends what is written so far
+  void flush();
+  void end();
+
+  void sendError(int status);
+  // Sends a whole file, such as an SD library File, HTTP_FILE_BLOCK bytes
+  // at a time.  A template so that the library doesn't need SD.  If the file
+  // can't be read or sent to its end the connection is closed, as the client
+  // was promised its size.
+  template <class FileT> void sendFile(FileT &file, const char *contentType)
+  {
+    bool first = true;
+    long left = file.size();
+    int n;
+
+    beginResponse(200, contentType, left);
+    if (_noBody)
+      left = 0;
+    while (left > 0) {
+      n = file.read(_fileBlock, left < _fileBlockSize ? left : _fileBlockSize);
+      if (n <= 0 || write(_fileBlock, n) < (size_t)n)
+        break;
+      left -= n;
+      // the headers and first block go at once, the rest a buffer at a time
+      if (first)
+        flush();
+      first = false;
+    }
+    if (left > 0)
+      _keepAlive = false;
+    end();
+  }
+
+  friend class HttpServer;
+
+private:
+  uint8_t _sock;
+  uint8_t _state;
+  uint8_t _len;              // characters in the token being parsed
+  uint8_t _header;           // header whose value is being parsed
+  bool _http11;
+  bool _keepAlive;
+  bool _chunked;             // response sent in chunks
+  bool _inChunk;
+  bool _noBody;              // response to HEAD
+  uint16_t _chunkAt;         // queue offset of the open chunk's size line
+  uint16_t _chunkLen;
+  uint16_t _room;            // Tx buffer room last seen, less what was queued since
+  long _contentLength;
+  long _bodyLeft;            // request body not yet read
+  int _error;                // status to answer a bad request with
+  char _method[8];
+  char _path[HTTP_PATH_SIZE];
+  char _token[20];           // version, header name or header value
+
+  static uint8_t _fileBlock[];  // sendFile() buffer, one for every request
+  static const uint16_t _fileBlockSize;
+
+  void reset();
+  size_t parse(const uint8_t *data, size_t len);
+  void endHeader();
+  size_t queue(const uint8_t *buf, size_t size);
+  bool makeRoom();
+  void endChunk();
+  static size_t parseCallback(const uint8_t *data, size_t len, void *arg);
+};
+
+// Serves HTTP on top of EthernetServer, one request per call to available()
+// and the connections taken in turn.  The sockets it uses shouldn't be given
+// handlers with setSocketHandler(), as pollSockets() would send half built
+// chunks.
+//
+// backlog is the number of sockets kept listening.  More of them take more
+// clients at once, but each is a socket that DHCP, DNS, NTP or an
+// EthernetClient can't have until it is connected and closed again.  The
+// default, one less than the chip has, keeps a socket free for them while
+// the server is idle.
+class HttpServer {
+public:
+  HttpServer(uint16_t port = 80, uint8_t backlog = MAX_SOCK_NUM - 1);
+  void begin();
+  // A request whose headers have all arrived, or NULL.  Requests that can't
+  // be parsed are answered with an error here.
+  HttpRequest *available();
+  void setIdleTimeout(unsigned long ms) { _server.setIdleTimeout(ms); }
+
+private:
+  EthernetServer _server;
+  HttpRequest _requests[MAX_SOCK_NUM];
+};
+
+#endif
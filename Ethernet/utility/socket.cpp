@@ -3,12 +3,27 @@
 
 static uint16_t local_port;
 
+// TCP send state, see sendQueue() and sendFlush()
+static uint8_t send_busy;                  // bit per socket with a SEND not yet acknowledged
+static uint16_t tx_wr[MAX_SOCK_NUM];       // TX_WR when the queued data started
+static uint16_t tx_pending[MAX_SOCK_NUM];  // bytes queued after TX_WR
+static uint16_t tx_free[MAX_SOCK_NUM];     // room left after them
+static uint8_t send_moved;                 // bit per socket that queued or sent data, see sendProgress()
+
+// Event handlers, see pollSockets()
+static SocketHandler handler[MAX_SOCK_NUM];
+static void *handler_arg[MAX_SOCK_NUM];
+static uint8_t handled;                    // bit per socket with a handler
+
 /**
  * @brief	This Socket function initialize the channel in perticular mode, and set the port and wait for W5100 done it.
  * @return 	1 for success else 0.
  */
 uint8_t socket(SOCKET s, uint8_t protocol, uint16_t port, uint8_t flag)
 {
+  if (W5100.getTXMaxSize(s) == 0 || W5100.getRXMaxSize(s) == 0)
+    return 0; // no buffer memory, see W5100Class::setBufferSizes()
+
   if ((protocol == SnMR::TCP) || (protocol == SnMR::UDP) || (protocol == SnMR::IPRAW) || (protocol == SnMR::MACRAW) || (protocol == SnMR::PPPOE))
   {
     close(s);
@@ -37,6 +52,8 @@ void close(SOCKET s)
 {
   W5100.execCmdSn(s, Sock_CLOSE);
   W5100.writeSnIR(s, 0xFF);
+  send_busy &= ~(1 << s);
+  tx_pending[s] = 0;
 }
 
 
@@ -90,7 +107,10 @@ void disconnect(SOCKET s)
 
 
 /**
- * @brief	This function used to send the data in TCP mode
+ * @brief	This function used to send the data in TCP mode.
+ * 		It returns once the SEND command is issued and does not wait for SEND_OK; the
+ * 		next send(), sendFlush() or sendWait() waits for it.  A return of len means the
+ * 		data is in the chip, not that it has been sent.
  * @return	1 for success else 0.
  */
 uint16_t send(SOCKET s, const uint8_t * buf, uint16_t len)
@@ -99,8 +119,11 @@ uint16_t send(SOCKET s, const uint8_t * buf, uint16_t len)
   uint16_t ret=0;
   uint16_t freesize=0;
 
-  if (len > W5100.SSIZE) 
-    ret = W5100.SSIZE; // check size not to exceed MAX size.
+  // data queued by sendQueue() goes first
+  sendFlush(s);
+
+  if (len > W5100.getTXMaxSize(s)) 
+    ret = W5100.getTXMaxSize(s); // check size not to exceed MAX size.
   else 
     ret = len;
 
@@ -117,23 +140,204 @@ uint16_t send(SOCKET s, const uint8_t * buf, uint16_t len)
   } 
   while (freesize < ret);
 
+  if (ret == 0 || !sendWait(s))
+    return 0;
+
   // copy data
   W5100.send_data_processing(s, (uint8_t *)buf, ret);
   W5100.execCmdSn(s, Sock_SEND);
+  send_busy |= 1 << s;
+  send_moved |= 1 << s;
+  return ret;
+}
 
-  /* +2008.01 bj */
-  while ( (W5100.readSnIR(s) & SnIR::SEND_OK) != SnIR::SEND_OK ) 
+
+/**
+ * @brief	Checks whether the last SEND command of a TCP socket is complete, without waiting.
+ * 		A socket that has been closed has nothing left to send.
+ * @return	1 if the socket can take another SEND command, else 0.
+ */
+uint8_t sendDone(SOCKET s)
+{
+  if (!(send_busy & (1 << s)))
+    return 1;
+  if (W5100.readSnIR(s) & SnIR::SEND_OK)
+  {
+    W5100.writeSnIR(s, SnIR::SEND_OK);
+    send_busy &= ~(1 << s);
+    return 1;
+  }
+  if (W5100.readSnSR(s) == SnSR::CLOSED)
   {
-    /* m2008.01 [bj] : reduce code */
-    if ( W5100.readSnSR(s) == SnSR::CLOSED )
+    close(s);
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * @brief	Waits until the last SEND command of a TCP socket is complete.  The chip takes
+ * 		one SEND at a time.
+ * @return	1 for success, 0 if the socket closed while sending.
+ */
+uint8_t sendWait(SOCKET s)
+{
+  while (send_busy & (1 << s))
+  {
+    if (W5100.readSnIR(s) & SnIR::SEND_OK)
+    {
+      W5100.writeSnIR(s, SnIR::SEND_OK);
+      send_busy &= ~(1 << s);
+    }
+    else if (W5100.readSnSR(s) == SnSR::CLOSED)
     {
       close(s);
       return 0;
     }
   }
-  /* +2008.01 bj */
-  W5100.writeSnIR(s, SnIR::SEND_OK);
-  return ret;
+  return 1;
+}
+
+
+/**
+ * @brief	Waits until the chip has sent the datagram of the last sendPacket(), so that the
+ * 		destination registers can be changed.
+ * @return	1 for success, 0 if it timed out waiting for ARP.
+ */
+static uint8_t udpWait(SOCKET s)
+{
+  uint8_t ir;
+
+  while (send_busy & (1 << s))
+  {
+    ir = W5100.readSnIR(s);
+    if (ir & SnIR::SEND_OK)
+    {
+      W5100.writeSnIR(s, SnIR::SEND_OK);
+      send_busy &= ~(1 << s);
+    }
+    else if (ir & SnIR::TIMEOUT)
+    {
+      W5100.writeSnIR(s, (SnIR::SEND_OK | SnIR::TIMEOUT));
+      send_busy &= ~(1 << s);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/**
+ * @brief	Copies data into the Tx buffer of a TCP socket behind the data already queued,
+ * 		without sending it.  sendFlush() sends everything queued with one SEND command.
+ * 		TX_WR and TX_FSR are read when the queue starts, not for every call.
+ * @return	Number of bytes queued, 0 if the buffer is full or the socket is not connected.
+ */
+uint16_t sendQueue(SOCKET s, const uint8_t * buf, uint16_t len)
+{
+  if (tx_pending[s] == 0)
+  {
+    uint8_t status = W5100.readSnSR(s);
+    if ((status != SnSR::ESTABLISHED) && (status != SnSR::CLOSE_WAIT))
+      return 0;
+    tx_wr[s] = W5100.readSnTX_WR(s);
+    tx_free[s] = W5100.getTXFreeSize(s);
+  }
+  if (len > tx_free[s])
+  {
+    // the peer may have acknowledged more since
+    tx_free[s] = W5100.getTXFreeSize(s) - tx_pending[s];
+    if (len > tx_free[s])
+      len = tx_free[s];
+  }
+  if (len == 0)
+    return 0;
+
+  W5100.write_data(s, tx_wr[s] + tx_pending[s], buf, len);
+  tx_pending[s] += len;
+  tx_free[s] -= len;
+  send_moved |= 1 << s;
+  return len;
+}
+
+
+/**
+ * @brief	Returns the number of bytes queued by sendQueue() and not yet sent.
+ */
+uint16_t sendPending(SOCKET s)
+{
+  return tx_pending[s];
+}
+
+
+/**
+ * @brief	Sends the data queued by sendQueue() with one SEND command.  Waits for the
+ * 		previous SEND to complete, but not for this one.
+ * @return	Number of bytes sent, 0 if there were none or the socket is closed.
+ */
+uint16_t sendFlush(SOCKET s)
+{
+  uint16_t len = tx_pending[s];
+
+  if (len == 0)
+    return 0;
+  tx_pending[s] = 0;
+  if (!sendWait(s))
+    return 0;
+  W5100.writeSnTX_WR(s, tx_wr[s] + len);
+  W5100.execCmdSn(s, Sock_SEND);
+  send_busy |= 1 << s;
+  send_moved |= 1 << s;
+  return len;
+}
+
+
+/**
+ * @brief	Tells whether send(), sendQueue() or sendFlush() have moved data on socket s
+ * 		since the last call, so that a server can tell a slow reply from an idle
+ * 		connection.
+ * @return	1 if they have, else 0.
+ */
+uint8_t sendProgress(SOCKET s)
+{
+  uint8_t moved = send_moved & (1 << s);
+
+  send_moved &= ~(1 << s);
+  return moved != 0;
+}
+
+
+/**
+ * @brief	Returns the room in the Tx buffer behind the data queued by sendQueue(), with
+ * 		TX_FSR read again for what the peer has acknowledged since.
+ * @return	Number of bytes sendQueue() will take, 0 if the socket is not connected.
+ */
+uint16_t sendRoom(SOCKET s)
+{
+  if (tx_pending[s] == 0)
+  {
+    uint8_t status = W5100.readSnSR(s);
+    if ((status != SnSR::ESTABLISHED) && (status != SnSR::CLOSE_WAIT))
+      return 0;
+    tx_wr[s] = W5100.readSnTX_WR(s);
+  }
+  tx_free[s] = W5100.getTXFreeSize(s) - tx_pending[s];
+  return tx_free[s];
+}
+
+
+/**
+ * @brief	Overwrites bytes already queued by sendQueue(), offset counted from the first
+ * 		byte queued since the last sendFlush().
+ * @return	1 for success, 0 if they are not all in the queue.
+ */
+uint8_t sendRewrite(SOCKET s, uint16_t offset, const uint8_t * buf, uint16_t len)
+{
+  if ((uint32_t)offset + len > tx_pending[s])
+    return 0;
+  W5100.write_data(s, tx_wr[s] + offset, buf, len);
+  return 1;
 }
 
 
@@ -199,7 +403,7 @@ uint16_t sendto(SOCKET s, const uint8_t *buf, uint16_t len, uint8_t *addr, uint1
 {
   uint16_t ret=0;
 
-  if (len > W5100.SSIZE) ret = W5100.SSIZE; // check size not to exceed MAX size.
+  if (len > W5100.getTXMaxSize(s)) ret = W5100.getTXMaxSize(s); // check size not to exceed MAX size.
   else ret = len;
 
   if
@@ -213,6 +417,7 @@ uint16_t sendto(SOCKET s, const uint8_t *buf, uint16_t len, uint8_t *addr, uint1
   }
   else
   {
+    udpWait(s);
     W5100.writeSnDIPR(s, addr);
     W5100.writeSnDPORT(s, port);
 
@@ -316,8 +521,8 @@ uint16_t igmpsend(SOCKET s, const uint8_t * buf, uint16_t len)
   uint8_t status=0;
   uint16_t ret=0;
 
-  if (len > W5100.SSIZE) 
-    ret = W5100.SSIZE; // check size not to exceed MAX size.
+  if (len > W5100.getTXMaxSize(s)) 
+    ret = W5100.getTXMaxSize(s); // check size not to exceed MAX size.
   else 
     ret = len;
 
@@ -370,6 +575,7 @@ int startUDP(SOCKET s, uint8_t* addr, uint16_t port)
   }
   else
   {
+    udpWait(s);
     W5100.writeSnDIPR(s, addr);
     W5100.writeSnDPORT(s, port);
     return 1;
@@ -398,3 +604,136 @@ int sendUDP(SOCKET s)
   return 1;
 }
 
+
+/**
+ * @brief	Receives whole UDP datagrams, header and data together, with one read of the Rx
+ * 		buffer.  Reads as much as is waiting or fits in buf, then keeps the datagrams
+ * 		that came in whole and leaves the rest for next time.  The headers are parsed
+ * 		where they are, nothing is copied twice.
+ * @return	Number of bytes put in buf, 0 if nothing was waiting.
+ */
+uint16_t recvPackets(SOCKET s, uint8_t *buf, uint16_t len, uint8_t count)
+{
+  uint16_t size = W5100.getRXReceivedSize(s);
+  uint16_t ptr, data_len;
+  uint16_t got = 0;   // bytes of whole datagrams in buf
+  uint16_t skip = 0;  // bytes of a datagram cut to fit, not in buf
+
+  if (size < 8 || len < 8 || count == 0)
+    return 0;
+  if (size > len)
+    size = len;
+
+  ptr = W5100.readSnRX_RD(s);
+  W5100.read_data(s, (uint8_t *)ptr, buf, size);
+
+  while (count-- && got + 8 <= size)
+  {
+    data_len = buf[got + 6];
+    data_len = (data_len << 8) + buf[got + 7];
+    if (data_len > size - got - 8)
+    {
+      if (got > 0)
+        break;
+      // a datagram bigger than buf, keep what fitted and drop the rest
+      skip = data_len - (size - 8);
+      data_len = size - 8;
+      buf[6] = data_len >> 8;
+      buf[7] = data_len;
+    }
+    got += 8 + data_len;
+  }
+
+  W5100.writeSnRX_RD(s, ptr + got + skip);
+  W5100.execCmdSn(s, Sock_RECV);
+  return got;
+}
+
+
+/**
+ * @brief	Sends a UDP datagram from one buffer: one copy into the Tx buffer and one SEND
+ * 		command.  Waits for the SEND of the previous datagram, not for this one, and
+ * 		as the chip empties the Tx buffer on each SEND it has room for up to the
+ * 		buffer size without checking.
+ * 		A previous datagram that timed out waiting for ARP is not reported, as
+ * 		UDP doesn't report lost datagrams; this one is sent all the same.
+ * @return	Number of bytes sent, 0 for an invalid address.
+ */
+uint16_t sendPacket(SOCKET s, const uint8_t *buf, uint16_t len, uint8_t *addr, uint16_t port)
+{
+  uint16_t ptr;
+
+  if (len > W5100.getTXMaxSize(s))
+    len = W5100.getTXMaxSize(s);
+  if (len == 0)
+    return 0;
+  udpWait(s);
+  if (!startUDP(s, addr, port))
+    return 0;
+
+  ptr = W5100.readSnTX_WR(s);
+  W5100.write_data(s, ptr, buf, len);
+  W5100.writeSnTX_WR(s, ptr + len);
+  W5100.execCmdSn(s, Sock_SEND);
+  send_busy |= 1 << s;
+  return len;
+}
+
+
+/**
+ * @brief	Sets the function pollSockets() calls with the events of socket s.  NULL
+ * 		removes it and leaves the socket to the blocking functions.
+ */
+void setSocketHandler(SOCKET s, SocketHandler fn, void *arg)
+{
+  handler[s] = fn;
+  handler_arg[s] = arg;
+  if (fn)
+    handled |= 1 << s;
+  else
+    handled &= ~(1 << s);
+}
+
+
+/**
+ * @brief	Reads the interrupt flags of all sockets in one access and calls the handler
+ * 		of each socket with events, after clearing them in Sn_IR.  Data queued by
+ * 		sendAsync() while the last SEND was going out is sent on its SEND_OK.
+ * 		Costs one register read when nothing has happened.
+ * @return	Number of handlers called.
+ */
+uint8_t pollSockets()
+{
+  uint8_t ir = W5100.readSocketIR() & handled;
+  uint8_t n = 0;
+
+  for (SOCKET s = 0; ir; s++, ir >>= 1)
+  {
+    if (!(ir & 1))
+      continue;
+    uint8_t events = W5100.readSnIR(s);
+    W5100.writeSnIR(s, events);
+    if (events & (SnIR::SEND_OK | SnIR::TIMEOUT))
+      send_busy &= ~(1 << s);
+    if (events & SnIR::SEND_OK)
+      sendFlush(s);
+    handler[s](s, events, handler_arg[s]);
+    n++;
+  }
+  return n;
+}
+
+
+/**
+ * @brief	Sends data in TCP mode without waiting.  Queues what fits in the Tx buffer and
+ * 		issues SEND at once if the chip has finished the last one, otherwise
+ * 		pollSockets() issues it when SEND_OK comes.
+ * @return	Number of bytes taken, 0 if the buffer is full or the socket is not connected.
+ */
+uint16_t sendAsync(SOCKET s, const uint8_t * buf, uint16_t len)
+{
+  len = sendQueue(s, buf, len);
+  if (sendDone(s))
+    sendFlush(s);
+  return len;
+}
@@ -9,6 +9,8 @@ extern uint8_t connect(SOCKET s, uint8_t * addr, uint16_t port); // Establish TC
 extern void disconnect(SOCKET s); // disconnect the connection
 extern uint8_t listen(SOCKET s);	// Establish TCP connection (Passive connection)
 extern uint16_t send(SOCKET s, const uint8_t * buf, uint16_t len); // Send data (TCP)
+extern uint8_t sendDone(SOCKET s); // Last TCP SEND complete, doesn't wait
+extern uint8_t sendWait(SOCKET s); // Wait for the last TCP SEND to complete
 extern int16_t recv(SOCKET s, uint8_t * buf, int16_t len);	// Receive data (TCP)
 extern uint16_t peek(SOCKET s, uint8_t *buf);
 extern uint16_t sendto(SOCKET s, const uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t port); // Send data (UDP/IP RAW)
@@ -37,5 +39,79 @@ uint16_t bufferData(SOCKET s, uint16_t offset, const uint8_t* buf, uint16_t len)
 */
 int sendUDP(SOCKET s);
 
+// Functions to move whole UDP datagrams, so that each costs one access to the buffer
+/*
+  @brief Copies the datagrams waiting, each with its 8 byte header, into buf with one read
+  of the Rx buffer and frees them with one RECV.  Stops after count datagrams or at the
+  first one that doesn't fit behind the others.  A datagram bigger than len on its own is
+  cut to len and the length in its header changed to match.
+  @return Number of bytes put in buf, 0 if nothing was waiting
+*/
+extern uint16_t recvPackets(SOCKET s, uint8_t * buf, uint16_t len, uint8_t count);
+/*
+  @brief Sends len bytes of buf as one UDP datagram, without waiting for it to go out.  The
+  next sendPacket waits for the chip to finish this one, and sends even if that one timed
+  out waiting for ARP.
+  @return Number of bytes sent, 0 if the address is invalid
+*/
+extern uint16_t sendPacket(SOCKET s, const uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t port);
+
+// Functions to batch TCP output, so that many small writes go out in one SEND
+/*
+  @brief Copies up to len bytes into the Tx buffer behind the data already queued,
+  without sending it.
+  @return Number of bytes queued, 0 if the buffer is full or the socket is not connected
+*/
+extern uint16_t sendQueue(SOCKET s, const uint8_t * buf, uint16_t len);
+/*
+  @brief Number of bytes queued by sendQueue and not yet sent.
+*/
+extern uint16_t sendPending(SOCKET s);
+/*
+  @brief Sends the queued data with one SEND command, after waiting for the previous
+  SEND to complete.
+  @return Number of bytes sent, 0 if none were queued or the socket is closed
+*/
+extern uint16_t sendFlush(SOCKET s);
+/*
+  @brief Whether send, sendQueue or sendFlush moved data on the socket since the last call.
+  @return 1 if they did, else 0
+*/
+extern uint8_t sendProgress(SOCKET s);
+/*
+  @brief Room left in the Tx buffer behind the queued data, read from the chip again.
+  @return Bytes sendQueue can take now, 0 if the socket is not connected
+*/
+extern uint16_t sendRoom(SOCKET s);
+/*
+  @brief Overwrites len queued bytes starting offset bytes into the queue, for a length
+  or checksum only known once the data behind it is queued.
+  @return 1 for success, 0 if the bytes are not all queued
+*/
+extern uint8_t sendRewrite(SOCKET s, uint16_t offset, const uint8_t * buf, uint16_t len);
+
+// Event driven sockets, so that one sketch can serve several connections without waiting
+// on any of them.  connect(), listen(), disconnect() and recv() don't wait already.
+/*
+  @brief Called by pollSockets with the socket's Sn_IR bits: SnIR::CON when connected,
+  SnIR::RECV when data arrived, SnIR::SEND_OK when the last SEND is done and there is
+  room again, SnIR::DISCON when the peer closed and SnIR::TIMEOUT when the connection
+  or an ARP request timed out.
+*/
+typedef void (*SocketHandler)(SOCKET s, uint8_t events, void *arg);
+extern void setSocketHandler(SOCKET s, SocketHandler fn, void *arg);
+/*
+  @brief Reads the chip's socket interrupt flags once and calls the handlers of the
+  sockets with events.
+  @return Number of handlers called
+*/
+extern uint8_t pollSockets();
+/*
+  @brief TCP send that never waits, see sendQueue.  The SEND goes out now or from
+  pollSockets on the SEND_OK of the previous one.
+  @return Number of bytes taken, 0 if the buffer is full or the socket is not connected
+*/
+extern uint16_t sendAsync(SOCKET s, const uint8_t * buf, uint16_t len);
+
 #endif
 /* _SOCKET_H_ */
@@ -16,28 +16,179 @@
 // W5100 controller instance
 W5100Class W5100;
 
+uint8_t W5100Class::chip = 0;
+uint16_t W5100Class::CH_BASE = 0x0400;
+
 #define TX_RX_MAX_BUF_SIZE 2048
 #define TX_BUF 0x1100
 #define RX_BUF (TX_BUF + TX_RX_MAX_BUF_SIZE)
 
+// Buffer addresses.  The W5500 has a block for each socket buffer instead,
+// see readSnBuf() and writeSnBuf().
 #define TXBUF_BASE 0x4000
 #define RXBUF_BASE 0x6000
+#define TXBUF_BASE_W5200 0x8000
+#define RXBUF_BASE_W5200 0xC000
+
+W5100Class::W5100Class()
+{
+  for (int i=0; i<SOCKETS; i++) {
+    TXKB[i] = SSIZE >> 10;
+    RXKB[i] = SSIZE >> 10;
+  }
+}
 
-void W5100Class::init(void)
+uint8_t W5100Class::init(void)
 {
   delay(300);
 
   SPI.begin();
   initSS();
-  
-  writeMR(1<<RST);
-  writeTMSR(0x55);
-  writeRMSR(0x55);
 
-  for (int i=0; i<MAX_SOCK_NUM; i++) {
-    SBASE[i] = TXBUF_BASE + SSIZE * i;
-    RBASE[i] = RXBUF_BASE + RSIZE * i;
+  if (isW5200())
+    CH_BASE = 0x4000;
+  else if (isW5500())
+    CH_BASE = 0x1000;
+  else if (isW5100())
+    CH_BASE = 0x0400;
+  else {
+    chip = 0;
+    return 0;
+  }
+  if (!partition()) {
+    // sizes set for a larger chip, fall back to the reset default
+    for (int i=0; i<SOCKETS; i++)
+      TXKB[i] = RXKB[i] = SSIZE >> 10;
+    partition();
+  }
+  return chip;
+}
+
+uint8_t W5100Class::setBufferSizes(const uint8_t *txKB, const uint8_t *rxKB)
+{
+  uint8_t oldTX[SOCKETS], oldRX[SOCKETS];
+
+  for (int i=0; i<SOCKETS; i++) {
+    if (txKB[i] > 8 || (txKB[i] & (txKB[i] - 1)) ||
+        rxKB[i] > 8 || (rxKB[i] & (rxKB[i] - 1)))
+      return 0;
+  }
+  memcpy(oldTX, TXKB, SOCKETS);
+  memcpy(oldRX, RXKB, SOCKETS);
+  memcpy(TXKB, txKB, SOCKETS);
+  memcpy(RXKB, rxKB, SOCKETS);
+  if (chip && !partition()) {
+    memcpy(TXKB, oldTX, SOCKETS);
+    memcpy(RXKB, oldRX, SOCKETS);
+    partition();
+    return 0;
   }
+  return 1;
+}
+
+// Give each socket its TX and RX memory, one after the other as the chip
+// allocates it.  Returns 0 if the sizes do not fit the chip.
+uint8_t W5100Class::partition()
+{
+  uint16_t txBase = chip == 51 ? TXBUF_BASE : TXBUF_BASE_W5200;
+  uint16_t rxBase = chip == 51 ? RXBUF_BASE : RXBUF_BASE_W5200;
+  uint8_t memKB = chip == 51 ? 8 : 16;
+  uint8_t txUsed = 0, rxUsed = 0;
+  uint8_t tmsr = 0, rmsr = 0;
+
+  for (int i=0; i<SOCKETS; i++) {
+    // the W5100 gives a socket none only once its memory has run out
+    if (chip == 51 && ((!TXKB[i] && txUsed < memKB) ||
+                       (!RXKB[i] && rxUsed < memKB)))
+      return 0;
+    txUsed += TXKB[i];
+    rxUsed += RXKB[i];
+  }
+  if (txUsed > memKB || rxUsed > memKB)
+    return 0;
+
+  txUsed = rxUsed = 0;
+  for (int i=0; i<SOCKETS; i++) {
+    // a mask of 0xFFFF gives a maximum size of 0 for a socket without memory
+    SMASK[i] = ((uint16_t)TXKB[i] << 10) - 1;
+    RMASK[i] = ((uint16_t)RXKB[i] << 10) - 1;
+    SBASE[i] = txBase + ((uint16_t)txUsed << 10);
+    RBASE[i] = rxBase + ((uint16_t)rxUsed << 10);
+    txUsed += TXKB[i];
+    rxUsed += RXKB[i];
+    // W5100 memory size registers have two bits per socket, 1KB << n;
+    // sockets left without memory get none from the chip
+    if (TXKB[i])
+      tmsr |= (TXKB[i] == 8 ? 3 : TXKB[i] >> 1) << (2 * i);
+    if (RXKB[i])
+      rmsr |= (RXKB[i] == 8 ? 3 : RXKB[i] >> 1) << (2 * i);
+    if (chip != 51) {
+      writeSnTX_SIZE(i, TXKB[i]);
+      writeSnRX_SIZE(i, RXKB[i]);
+    }
+  }
+  if (chip == 51) {
+    writeTMSR(tmsr);
+    writeRMSR(rmsr);
+  }
+  else {
+    // the W5200 and W5500 have eight sockets, the rest are not used
+    for (int i=SOCKETS; i<8; i++) {
+      writeSnTX_SIZE(i, 0);
+      writeSnRX_SIZE(i, 0);
+    }
+  }
+  return 1;
+}
+
+uint8_t W5100Class::softReset(void)
+{
+  writeMR(1<<RST);
+  // the reset bit clears itself when the chip is ready
+  for (uint8_t i=0; i<20; i++) {
+    if (readMR() == 0)
+      return 1;
+    delay(1);
+  }
+  return 0;
+}
+
+uint8_t W5100Class::isW5100(void)
+{
+  chip = 51;
+  if (!softReset()) return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10) return 0;
+  writeMR(0x12);
+  if (readMR() != 0x12) return 0;
+  writeMR(0x00);
+  return readMR() == 0x00;
+}
+
+uint8_t W5100Class::isW5200(void)
+{
+  chip = 52;
+  if (!softReset()) return 0;
+  writeMR(0x08);
+  if (readMR() != 0x08) return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10) return 0;
+  writeMR(0x00);
+  if (readMR() != 0x00) return 0;
+  return readVERSIONR_W5200() == 3;
+}
+
+uint8_t W5100Class::isW5500(void)
+{
+  chip = 55;
+  if (!softReset()) return 0;
+  writeMR(0x08);
+  if (readMR() != 0x08) return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10) return 0;
+  writeMR(0x00);
+  if (readMR() != 0x00) return 0;
+  return readVERSIONR_W5500() == 4;
 }
 
 uint16_t W5100Class::getTXFreeSize(SOCKET s)
@@ -65,6 +216,23 @@ uint16_t W5100Class::getRXReceivedSize(SOCKET s)
 }
 
 
+uint8_t W5100Class::readSocketIR()
+{
+  if (chip == 51)
+    return readIR() & 0x0F;
+  if (chip == 52)
+    return readIR2_W5200();
+  // W5500 SIR, at the address beginFrame() moves to RTR
+  setSS();
+  SPI.transfer(0x00);
+  SPI.transfer(0x17);
+  SPI.transfer(0x00);
+  uint8_t ir = SPI.transfer(0);
+  resetSS();
+  return ir;
+}
+
+
 void W5100Class::send_data_processing(SOCKET s, const uint8_t *data, uint16_t len)
 {
   // This is same as having no offset in a call to send_data_processing_offset
@@ -75,22 +243,31 @@ void W5100Class::send_data_processing_offset(SOCKET s, uint16_t data_offset, con
 {
   uint16_t ptr = readSnTX_WR(s);
   ptr += data_offset;
-  uint16_t offset = ptr & SMASK;
+  write_data(s, ptr, data, len);
+  ptr += len;
+  writeSnTX_WR(s, ptr);
+}
+
+void W5100Class::write_data(SOCKET s, uint16_t ptr, const uint8_t *data, uint16_t len)
+{
+  uint16_t offset = ptr & SMASK[s];
   uint16_t dstAddr = offset + SBASE[s];
 
-  if (offset + len > SSIZE) 
+  if (chip == 55)
+  {
+    // the W5500 wraps the pointer within the socket's buffer itself
+    writeSnBuf(s, ptr, data, len);
+  }
+  else if (offset + len > SMASK[s] + 1) 
   {
     // Wrap around circular buffer
-    uint16_t size = SSIZE - offset;
+    uint16_t size = SMASK[s] + 1 - offset;
     write(dstAddr, data, size);
     write(SBASE[s], data + size, len - size);
   } 
   else {
     write(dstAddr, data, len);
   }
-
-  ptr += len;
-  writeSnTX_WR(s, ptr);
 }
 
 
@@ -112,12 +289,18 @@ void W5100Class::read_data(SOCKET s, volatile uint8_t *src, volatile uint8_t *ds
   uint16_t src_mask;
   uint16_t src_ptr;
 
-  src_mask = (uint16_t)src & RMASK;
+  if (chip == 55)
+  {
+    readSnBuf(s, (uint16_t)(uintptr_t)src, (uint8_t *)dst, len);
+    return;
+  }
+
+  src_mask = (uint16_t)(uintptr_t)src & RMASK[s];
   src_ptr = RBASE[s] + src_mask;
 
-  if( (src_mask + len) > RSIZE ) 
+  if( (src_mask + len) > RMASK[s] + 1 ) 
   {
-    size = RSIZE - src_mask;
+    size = RMASK[s] + 1 - src_mask;
     read(src_ptr, (uint8_t *)dst, size);
     dst += size;
     read(RBASE[s], (uint8_t *) dst, len - size);
@@ -127,8 +310,72 @@ void W5100Class::read_data(SOCKET s, volatile uint8_t *src, volatile uint8_t *ds
 }
 
 
+/**
+ * @brief Send the header of a W5200 or W5500 frame.  The data follows
+ *        in the same frame, so SS stays low for the whole buffer.
+ */
+void W5100Class::beginFrame(uint16_t _addr, uint16_t _len, uint8_t _wr)
+{
+  if (chip == 52) {
+    // address, then op code and 15 bit length
+    SPI.transfer(_addr >> 8);
+    SPI.transfer(_addr & 0xFF);
+    SPI.transfer((_wr ? 0x80 : 0x00) | ((_len >> 8) & 0x7F));
+    SPI.transfer(_len & 0xFF);
+    return;
+  }
+  // W5500: offset, then block select and variable length data mode
+  uint8_t control;
+  if (_addr < 0x0100) {
+    // common registers; RTR and RCR are two bytes higher than on the W5100
+    if (_addr >= 0x0017 && _addr <= 0x0019)
+      _addr += 2;
+    control = 0x00;
+  }
+  else {
+    // socket n registers at CH_BASE + n * CH_SIZE
+    control = ((_addr >> 3) & 0xE0) | 0x08;
+    _addr &= 0xFF;
+  }
+  SPI.transfer(_addr >> 8);
+  SPI.transfer(_addr & 0xFF);
+  SPI.transfer(control | (_wr ? 0x04 : 0x00));
+}
+
+/**
+ * @brief Read the RX buffer of a W5500 socket, starting at pointer ptr.
+ */
+uint16_t W5100Class::readSnBuf(SOCKET s, uint16_t ptr, uint8_t *_buf, uint16_t _len)
+{
+  setSS();
+  SPI.transfer(ptr >> 8);
+  SPI.transfer(ptr & 0xFF);
+  SPI.transfer((s << 5) | 0x18);
+  for (uint16_t i=0; i<_len; i++)
+    _buf[i] = SPI.transfer(0);
+  resetSS();
+  return _len;
+}
+
+/**
+ * @brief Write the TX buffer of a W5500 socket, starting at pointer ptr.
+ */
+uint16_t W5100Class::writeSnBuf(SOCKET s, uint16_t ptr, const uint8_t *_buf, uint16_t _len)
+{
+  setSS();
+  SPI.transfer(ptr >> 8);
+  SPI.transfer(ptr & 0xFF);
+  SPI.transfer((s << 5) | 0x14);
+  for (uint16_t i=0; i<_len; i++)
+    SPI.transfer(_buf[i]);
+  resetSS();
+  return _len;
+}
+
 uint8_t W5100Class::write(uint16_t _addr, uint8_t _data)
 {
+  if (chip != 51)
+    return write(_addr, &_data, 1);
   setSS();  
   SPI.transfer(0xF0);
   SPI.transfer(_addr >> 8);
@@ -140,6 +387,14 @@ uint8_t W5100Class::write(uint16_t _addr, uint8_t _data)
 
 uint16_t W5100Class::write(uint16_t _addr, const uint8_t *_buf, uint16_t _len)
 {
+  if (chip != 51) {
+    setSS();
+    beginFrame(_addr, _len, 1);
+    for (uint16_t i=0; i<_len; i++)
+      SPI.transfer(_buf[i]);
+    resetSS();
+    return _len;
+  }
   for (uint16_t i=0; i<_len; i++)
   {
     setSS();    
@@ -155,6 +410,11 @@ uint16_t W5100Class::write(uint16_t _addr, const uint8_t *_buf, uint16_t _len)
 
 uint8_t W5100Class::read(uint16_t _addr)
 {
+  if (chip != 51) {
+    uint8_t _data;
+    read(_addr, &_data, 1);
+    return _data;
+  }
   setSS();  
   SPI.transfer(0x0F);
   SPI.transfer(_addr >> 8);
@@ -166,6 +426,14 @@ uint8_t W5100Class::read(uint16_t _addr)
 
 uint16_t W5100Class::read(uint16_t _addr, uint8_t *_buf, uint16_t _len)
 {
+  if (chip != 51) {
+    setSS();
+    beginFrame(_addr, _len, 0);
+    for (uint16_t i=0; i<_len; i++)
+      _buf[i] = SPI.transfer(0);
+    resetSS();
+    return _len;
+  }
   for (uint16_t i=0; i<_len; i++)
   {
     setSS();
@@ -129,7 +129,33 @@ public:
 class W5100Class {
 
 public:
-  void init();
+  /**
+   * @brief Reset the chip and find out which one is fitted.
+   *
+   * The W5200 and W5500 are probed first because the W5100 ignores their
+   * frames.  They move a whole buffer after one header, the W5100 needs a
+   * four byte frame for every byte.
+   * @return 51, 52 or 55 for a W5100, W5200 or W5500, 0 if none answered
+   */
+  W5100Class();
+  uint8_t init();
+  static uint8_t getChip() { return chip; }
+
+  /**
+   * @brief Set the TX and RX memory of each socket in KB: 0, 1, 2, 4 or 8,
+   *        one array entry per socket.
+   *
+   * The sizes are kept and applied by every init(), so this may be called
+   * before Ethernet.begin().  After init() the memory is partitioned again
+   * at once, which is only safe while all sockets are closed.  A socket
+   * with no memory cannot be opened.  The W5100 has 8KB for TX and 8KB
+   * for RX and gives a socket none only after the memory is used up, the
+   * W5200 and W5500 have 16KB each.  The default is 2KB per socket.
+   * @return 1 for success, 0 if a size is invalid or the sockets do not fit
+   */
+  uint8_t setBufferSizes(const uint8_t *txKB, const uint8_t *rxKB);
+  uint16_t getTXMaxSize(SOCKET s) { return SMASK[s] + 1; }
+  uint16_t getRXMaxSize(SOCKET s) { return RMASK[s] + 1; }
 
   /**
    * @brief	This function is being used for copy the data form Receive buffer of the chip to application buffer.
@@ -139,6 +165,14 @@ public:
    * the Rx memory uper-bound of socket.
    */
   void read_data(SOCKET s, volatile uint8_t * src, volatile uint8_t * dst, uint16_t len);
+
+  /**
+   * @brief	Copy data from the application buffer to the Tx buffer of the chip at pointer ptr.
+   * 
+   * The counterpart of read_data().  TX_WR is not changed, so data can be put in the
+   * buffer ahead of the SEND command that covers it.
+   */
+  void write_data(SOCKET s, uint16_t ptr, const uint8_t *src, uint16_t len);
   
   /**
    * @brief	 This function is being called by send() and sendto() function also. 
@@ -188,6 +222,12 @@ public:
   
   uint16_t getTXFreeSize(SOCKET s);
   uint16_t getRXReceivedSize(SOCKET s);
+
+  /**
+   * @brief	Read the interrupt flags of all sockets in one access, bit n set while Sn_IR
+   *        of socket n is not zero.
+   */
+  static uint8_t readSocketIR();
   
 
   // W5100 Registers
@@ -197,6 +237,14 @@ private:
   static uint16_t write(uint16_t addr, const uint8_t *buf, uint16_t len);
   static uint8_t read(uint16_t addr);
   static uint16_t read(uint16_t addr, uint8_t *buf, uint16_t len);
+  static void beginFrame(uint16_t addr, uint16_t len, uint8_t wr);
+  static uint16_t readSnBuf(SOCKET s, uint16_t ptr, uint8_t *buf, uint16_t len);
+  static uint16_t writeSnBuf(SOCKET s, uint16_t ptr, const uint8_t *buf, uint16_t len);
+  uint8_t partition();
+  static uint8_t softReset();
+  static uint8_t isW5100();
+  static uint8_t isW5200();
+  static uint8_t isW5500();
   
 #define __GP_REGISTER8(name, address)             \
   static inline void write##name(uint8_t _data) { \
@@ -207,13 +255,15 @@ private:
   }
 #define __GP_REGISTER16(name, address)            \
   static void write##name(uint16_t _data) {       \
-    write(address,   _data >> 8);                 \
-    write(address+1, _data & 0xFF);               \
+    uint8_t buf[2];                               \
+    buf[0] = _data >> 8;                          \
+    buf[1] = _data & 0xFF;                        \
+    write(address, buf, 2);                       \
   }                                               \
   static uint16_t read##name() {                  \
-    uint16_t res = read(address);                 \
-    res = (res << 8) + read(address + 1);         \
-    return res;                                   \
+    uint8_t buf[2];                               \
+    read(address, buf, 2);                        \
+    return (buf[0] << 8) | buf[1];                \
   }
 #define __GP_REGISTER_N(name, address, size)      \
   static uint16_t write##name(uint8_t *_buff) {   \
@@ -240,6 +290,9 @@ public:
   __GP_REGISTER8 (PMAGIC, 0x0029);    // PPP LCP Magic Number
   __GP_REGISTER_N(UIPR,   0x002A, 4); // Unreachable IP address in UDP mode
   __GP_REGISTER16(UPORT,  0x002E);    // Unreachable Port address in UDP mode
+  __GP_REGISTER8 (VERSIONR_W5200, 0x001F); // Chip version, W5200 only
+  __GP_REGISTER8 (VERSIONR_W5500, 0x0039); // Chip version, W5500 only
+  __GP_REGISTER8 (IR2_W5200, 0x0034);      // Socket interrupts, W5200 only
   
 #undef __GP_REGISTER8
 #undef __GP_REGISTER16
@@ -253,7 +306,7 @@ private:
   static inline uint16_t readSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t len);
   static inline uint16_t writeSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t len);
 
-  static const uint16_t CH_BASE = 0x0400;
+  static uint16_t CH_BASE; // Socket 0 registers, set by init() for the chip
   static const uint16_t CH_SIZE = 0x0100;
 
 #define __SOCKET_REGISTER8(name, address)                    \
@@ -265,16 +318,15 @@ private:
   }
 #define __SOCKET_REGISTER16(name, address)                   \
   static void write##name(SOCKET _s, uint16_t _data) {       \
-    writeSn(_s, address,   _data >> 8);                      \
-    writeSn(_s, address+1, _data & 0xFF);                    \
+    uint8_t buf[2];                                          \
+    buf[0] = _data >> 8;                                     \
+    buf[1] = _data & 0xFF;                                   \
+    writeSn(_s, address, buf, 2);                            \
   }                                                          \
   static uint16_t read##name(SOCKET _s) {                    \
-    uint16_t res = readSn(_s, address);                      \
-    uint16_t res2 = readSn(_s,address + 1);                  \
-    res = res << 8;                                          \
-    res2 = res2 & 0xFF;                                      \
-    res = res | res2;                                        \
-    return res;                                              \
+    uint8_t buf[2];                                          \
+    readSn(_s, address, buf, 2);                             \
+    return (buf[0] << 8) | buf[1];                           \
   }
 #define __SOCKET_REGISTER_N(name, address, size)             \
   static uint16_t write##name(SOCKET _s, uint8_t *_buff) {   \
@@ -303,6 +355,8 @@ public:
   __SOCKET_REGISTER16(SnRX_RSR,   0x0026)        // RX Free Size
   __SOCKET_REGISTER16(SnRX_RD,    0x0028)        // RX Read Pointer
   __SOCKET_REGISTER16(SnRX_WR,    0x002A)        // RX Write Pointer (supported?)
+  __SOCKET_REGISTER8(SnRX_SIZE,   0x001E)        // RX Memory Size, W5200/W5500
+  __SOCKET_REGISTER8(SnTX_SIZE,   0x001F)        // TX Memory Size, W5200/W5500
   
 #undef __SOCKET_REGISTER8
 #undef __SOCKET_REGISTER16
@@ -311,14 +365,16 @@ public:
 
 private:
   static const uint8_t  RST = 7; // Reset BIT
+  static uint8_t chip;           // 51, 52 or 55, 0 before init()
 
   static const int SOCKETS = 4;
-  static const uint16_t SMASK = 0x07FF; // Tx buffer MASK
-  static const uint16_t RMASK = 0x07FF; // Rx buffer MASK
 public:
-  static const uint16_t SSIZE = 2048; // Max Tx buffer size
+  static const uint16_t SSIZE = 2048; // Default Tx buffer size
 private:
-  static const uint16_t RSIZE = 2048; // Max Rx buffer size
+  uint8_t  TXKB[SOCKETS];  // Tx buffer size in KB
+  uint8_t  RXKB[SOCKETS];  // Rx buffer size in KB
+  uint16_t SMASK[SOCKETS]; // Tx buffer MASK, size - 1
+  uint16_t RMASK[SOCKETS]; // Rx buffer MASK, size - 1
   uint16_t SBASE[SOCKETS]; // Tx buffer base address
   uint16_t RBASE[SOCKETS]; // Rx buffer base address
 
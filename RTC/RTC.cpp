@@ -64,10 +64,16 @@
 #endif
 
 #include <Wire.h>
+#if (ARDUINO >= 100)
+#    include <WireRegisters.h>
+#endif
 #include <RTC.h>
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Manifest Constants
 #define DS1307_ADDRESS             0x68
+#define DS1307_SECONDS             0x00      // CH bit 7 stops the clock
+#define DS1307_CONTROL             0x07
+#define DS1307_TIME_REGS           0x7F      // seconds to year tick by themselves
 #define SECONDS_PER_DAY            86400L
 #define SECONDS_FROM_1970_TO_2000  946684800
 
@@ -86,6 +92,12 @@
 // Utility code, some of this could be exposed in the DateTime API if needed
 BYTE daysInMonth [] = { 31,28,31,30,31,30,31,31,30,31,30,31 } ;
 
+#if (ARDUINO >= 100)
+// Time keeping and control registers. Only the control register is served
+// from the cache, the time is read in one transaction.
+static WireRegisterMap <8> ds1307 (DS1307_ADDRESS, DS1307_SECONDS, DS1307_TIME_REGS, WIRE) ;
+#endif
+
 //-----------------------------------------------------------------------------
 //                                                                    Functions
 //-----------------------------------------------------------------------------
@@ -229,52 +241,54 @@ BYTE RTC_DS1307::isrunning (void)
 {
      BYTE      ss ;
 
-     WIRE.beginTransmission (DS1307_ADDRESS) ;
-     WIRE.write (0) ;
-     WIRE.endTransmission () ;
-
-     WIRE.requestFrom (DS1307_ADDRESS, 1) ;
-     ss = WIRE.read () ;
+     ss = ds1307.read (DS1307_SECONDS) ;
      return (! (ss >> 7)) ;
 }
 
 //-----------------------------------------------------------------------------
 //                                                                      .adjust
 //-----------------------------------------------------------------------------
+/*
+ *   The time registers are written in one burst, the control register with
+ *   them unless it already holds 0.
+ */
 void RTC_DS1307::adjust (const DateTime& dt)
 {
-     WIRE.beginTransmission (DS1307_ADDRESS) ;
-     WIRE.write (0) ;
-     WIRE.write (bin2bcd (dt.second ())) ;
-     WIRE.write (bin2bcd (dt.minute ())) ;
-     WIRE.write (bin2bcd (dt.hour ())) ;
-     WIRE.write (bin2bcd (0)) ;
-     WIRE.write (bin2bcd (dt.day ())) ;
-     WIRE.write (bin2bcd (dt.month ())) ;
-     WIRE.write (bin2bcd (dt.year () - 2000)) ;
-     WIRE.write (0) ;
-     WIRE.endTransmission () ;
+     BYTE      regs [8] ;
+
+     regs [0] = bin2bcd (dt.second ()) ;
+     regs [1] = bin2bcd (dt.minute ()) ;
+     regs [2] = bin2bcd (dt.hour ()) ;
+     regs [3] = bin2bcd (0) ;
+     regs [4] = bin2bcd (dt.day ()) ;
+     regs [5] = bin2bcd (dt.month ()) ;
+     regs [6] = bin2bcd (dt.year () - 2000) ;
+     regs [DS1307_CONTROL] = 0 ;
+     ds1307.write (DS1307_SECONDS, regs, 8) ;
+     ds1307.flush () ;
 }
 
 //-----------------------------------------------------------------------------
 //                                                                         .now
 //-----------------------------------------------------------------------------
+/*
+ *   The seven time registers come in one transaction, the register number
+ *   written and the time read back after a repeated start.
+ */
 DateTime RTC_DS1307::now ()
 {
-  WIRE.beginTransmission (DS1307_ADDRESS) ;
-  WIRE.write (0) ;
-  WIRE.endTransmission () ;
-
-  WIRE.requestFrom (DS1307_ADDRESS, 7) ;
-  BYTE ss = bcd2bin (WIRE.read () & 0x7F) ;
-  BYTE mm = bcd2bin (WIRE.read ()) ;
-  BYTE hh = bcd2bin (WIRE.read ()) ;
-  WIRE.read () ;
-  BYTE d = bcd2bin (WIRE.read ()) ;
-  BYTE m = bcd2bin (WIRE.read ()) ;
-  WORD y = bcd2bin (WIRE.read ()) + 2000 ;
-  
-  return DateTime (y, m, d, hh, mm, ss) ;
+     BYTE      regs [7] ;
+
+     memset (regs, 0xFF, sizeof (regs)) ;
+     ds1307.read (DS1307_SECONDS, regs, 7) ;
+     BYTE ss = bcd2bin (regs [0] & 0x7F) ;
+     BYTE mm = bcd2bin (regs [1]) ;
+     BYTE hh = bcd2bin (regs [2]) ;
+     BYTE d  = bcd2bin (regs [4]) ;
+     BYTE m  = bcd2bin (regs [5]) ;
+     WORD y  = bcd2bin (regs [6]) + 2000 ;
+
+     return DateTime (y, m, d, hh, mm, ss) ;
 }
 
 #else
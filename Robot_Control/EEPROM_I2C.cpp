@@ -19,12 +19,8 @@ void EEPROM_I2C::writeByte(unsigned int eeaddress, byte data){
 }
 
 byte EEPROM_I2C::readByte(unsigned int eeaddress){
-  int rdata;
-  this->_beginTransmission(eeaddress);
-  this->_endTransmission();
-  
-  Wire.requestFrom(DEVICEADDRESS,1);
-  if (Wire.available()) rdata = Wire.read();
+  byte rdata = 0;
+  readBuffer(eeaddress, &rdata, 1);
   return rdata;
 }
 
@@ -41,13 +37,15 @@ void EEPROM_I2C::writePage(unsigned int eeaddress, byte* data, byte length ){
   delay(10);                           // need some delay
 }
 
-void EEPROM_I2C::readBuffer(unsigned int eeaddress, byte *buffer, int length ){
-  this->_beginTransmission(eeaddress);
-  this->_endTransmission();
-  Wire.requestFrom(DEVICEADDRESS,length);
+// One sequential read of any length, the address written after the start
+// and the data read straight into buffer after a repeated start.  Returns
+// Wire.transfer()'s status, 0 if all of it was read.
+byte EEPROM_I2C::readBuffer(unsigned int eeaddress, byte *buffer, uint16_t length ){
+  byte address[2];
 
-  for ( int c = 0; c < length; c++ )
-    if (Wire.available()) buffer[c] = Wire.read();
+  address[0] = eeaddress >> 8;     // Address High Byte
+  address[1] = eeaddress & 0xFF;   // Address Low Byte
+  return Wire.transfer(DEVICEADDRESS, address, 2, buffer, length);
 }
 
 
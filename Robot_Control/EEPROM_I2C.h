@@ -18,7 +18,7 @@ class EEPROM_I2C{
 		byte readByte(unsigned int eeaddresspage);
 		
 		void writePage(unsigned int eeaddresspage, byte* data, byte length );
-		void readBuffer(unsigned int eeaddress, byte *buffer, int length );
+		byte readBuffer(unsigned int eeaddress, byte *buffer, uint16_t length );
 		
 		//uint16_t readPixel(uint16_t theMemoryAddress);
 		//void readImage(uint16_t theMemoryAddress, int width, int height);
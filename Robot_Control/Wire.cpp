@@ -154,6 +154,39 @@ uint8_t TwoWire::endTransmission(void)
   return endTransmission(true);
 }
 
+// queues a transaction and returns at once, see twi_submit()
+uint8_t TwoWire::submit(twi_transaction *t)
+{
+  return twi_submit(t);
+}
+
+uint8_t TwoWire::submit(twi_transaction *t, uint8_t address, const uint8_t *txData, uint16_t txLength, uint8_t *rxData, uint16_t rxLength, void (*onComplete)(twi_transaction *))
+{
+  t->address = address;
+  t->txData = txData;
+  t->txLength = txLength;
+  t->rxData = rxData;
+  t->rxLength = rxLength;
+  t->onComplete = onComplete;
+  return twi_submit(t);
+}
+
+// writes txLength bytes then reads rxLength bytes after a repeated start,
+// in one transaction and straight to and from the buffers, so neither is
+// limited to BUFFER_LENGTH.  Returns the same codes as endTransmission().
+uint8_t TwoWire::transfer(uint8_t address, const uint8_t *txData, uint16_t txLength, uint8_t *rxData, uint16_t rxLength)
+{
+  twi_transaction t;
+
+  t.address = address;
+  t.txData = txData;
+  t.txLength = txLength;
+  t.rxData = rxData;
+  t.rxLength = rxLength;
+  t.onComplete = NULL;
+  return twi_transfer(&t);
+}
+
 // must be called in:
 // slave tx event callback
 // or after beginTransmission(address)
@@ -292,6 +325,35 @@ void TwoWire::onRequest( void (*function)(void) )
   user_onRequest = function;
 }
 
+// bytes written to this slave go into the ring as they arrive, to be taken
+// out with slaveRead(), rather than to onReceive()
+void TwoWire::onReceiveStream(uint8_t *buffer, uint16_t size, void (*function)(int))
+{
+  twi_attachSlaveRxStream(buffer, size, function);
+}
+
+// sets function called from the interrupt for each byte a master reads,
+// rather than onRequest()
+void TwoWire::onRequestStream( int (*function)(uint16_t) )
+{
+  twi_attachSlaveTxStream(function);
+}
+
+int TwoWire::slaveAvailable(void)
+{
+  return twi_slaveAvailable();
+}
+
+int TwoWire::slaveRead(void)
+{
+  return twi_slaveRead();
+}
+
+int TwoWire::slavePeek(void)
+{
+  return twi_slavePeek();
+}
+
 // Preinstantiate Objects //////////////////////////////////////////////////////
 
 TwoWire Wire = TwoWire();
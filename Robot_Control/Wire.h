@@ -25,6 +25,10 @@
 #include <inttypes.h>
 #include "Stream.h"
 
+extern "C" {
+  #include "utility/twi.h"
+}
+
 #define BUFFER_LENGTH 32
 
 class TwoWire : public Stream
@@ -65,6 +69,14 @@ class TwoWire : public Stream
 	virtual void flush(void);
     void onReceive( void (*)(int) );
     void onRequest( void (*)(void) );
+    uint8_t submit(twi_transaction *);
+    uint8_t submit(twi_transaction *, uint8_t, const uint8_t *, uint16_t, uint8_t *, uint16_t, void (*)(twi_transaction *) = NULL);
+    uint8_t transfer(uint8_t, const uint8_t *, uint16_t, uint8_t *, uint16_t);
+    void onReceiveStream(uint8_t *, uint16_t, void (*)(int) = NULL);
+    void onRequestStream( int (*)(uint16_t) );
+    int slaveAvailable(void);
+    int slaveRead(void);
+    int slavePeek(void);
   
     inline size_t write(unsigned long n) { return write((uint8_t)n); }
     inline size_t write(long n) { return write((uint8_t)n); }
@@ -45,10 +45,13 @@ static volatile uint8_t twi_inRepStart;			// in the middle of a repeated start
 
 static void (*twi_onSlaveTransmit)(void);
 static void (*twi_onSlaveReceive)(uint8_t*, int);
+static void (*twi_onSlaveStreamEnd)(int);
+static int (*twi_onSlaveStreamTransmit)(uint16_t);
 
 static uint8_t twi_masterBuffer[TWI_BUFFER_LENGTH];
-static volatile uint8_t twi_masterBufferIndex;
-static volatile uint8_t twi_masterBufferLength;
+static uint8_t* volatile twi_masterData;	// twi_masterBuffer, or the caller's buffer
+static volatile uint16_t twi_masterBufferIndex;
+static volatile uint16_t twi_masterBufferLength;
 
 static uint8_t twi_txBuffer[TWI_BUFFER_LENGTH];
 static volatile uint8_t twi_txBufferIndex;
@@ -57,20 +60,55 @@ static volatile uint8_t twi_txBufferLength;
 static uint8_t twi_rxBuffer[TWI_BUFFER_LENGTH];
 static volatile uint8_t twi_rxBufferIndex;
 
+// slave receive stream, single byte indices so that neither side can see
+// the other's half written
+static volatile uint8_t* twi_ring;		// 0 when twi_rxBuffer is used
+static uint8_t twi_ringMask;			// size-1, the size a power of two
+static volatile uint8_t twi_ringHead;		// moved by the interrupt only
+static volatile uint8_t twi_ringTail;		// moved by twi_slaveRead() only
+static volatile uint16_t twi_slaveCount;	// bytes of this slave transfer so far
+static volatile int twi_slaveNext;		// next byte to send, -1 if none
+
 static volatile uint8_t twi_error;
 
+// outcome of a blocking read or write, kept apart from twi_error and
+// twi_masterBufferIndex, which a queued transaction chained straight
+// after it starts over
+static volatile uint8_t twi_result;
+static volatile uint16_t twi_resultLength;
+static volatile uint8_t twi_resultReady;
+
+static twi_transaction* volatile twi_queueHead;	// the transaction on the bus first
+static twi_transaction* volatile twi_queueTail;
+static volatile uint8_t twi_queued;		// the master transfer is twi_queueHead's
+
 /* 
  * Function twi_init
- * Desc     readys twi pins and sets twi bitrate
+ * Desc     readys twi pins and sets twi bitrate, dropping any queued
+ *          transactions with status 4
  * Input    none
  * Output   none
  */
 void twi_init(void)
 {
+  uint8_t oldSREG = SREG;
+  twi_transaction* t;
+
+  // drop transactions left queued, e.g. by a bus error, so that they
+  // aren't started again on the new bus.  Their callbacks aren't called.
+  cli();
+  for(t = twi_queueHead; t; t = t->next){
+    t->status = 4;
+  }
+  twi_queueHead = 0;
+  twi_queueTail = 0;
+  twi_queued = false;
+
   // initialize state
   twi_state = TWI_READY;
   twi_sendStop = true;		// default value
   twi_inRepStart = false;
+  SREG = oldSREG;
   
   // activate internal pullups for twi.
   digitalWrite(SDA, 1);
@@ -106,6 +144,7 @@ void twi_setAddress(uint8_t address)
  * Function twi_readFrom
  * Desc     attempts to become twi bus master and read a
  *          series of bytes from a device on the bus
+ *          straight into the array
  * Input    address: 7bit i2c device address
  *          data: pointer to byte array
  *          length: number of bytes to read into array
@@ -114,13 +153,6 @@ void twi_setAddress(uint8_t address)
  */
 uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sendStop)
 {
-  uint8_t i;
-
-  // ensure data will fit into buffer
-  if(TWI_BUFFER_LENGTH < length){
-    return 0;
-  }
-
   // wait until twi is ready, become master receiver
   while(TWI_READY != twi_state){
     continue;
@@ -131,6 +163,7 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
   twi_error = 0xFF;
 
   // initialize buffer iteration vars
+  twi_masterData = data;
   twi_masterBufferIndex = 0;
   twi_masterBufferLength = length-1;  // This is not intuitive, read on...
   // On receive, the previously configured ACK/NACK setting is transmitted in
@@ -151,33 +184,32 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
     // up. Also, don't enable the START interrupt. There may be one pending from the 
     // repeated start that we sent outselves, and that would really confuse things.
     twi_inRepStart = false;			// remember, we're dealing with an ASYNC ISR
+    twi_resultReady = false;
     TWDR = twi_slarw;
     TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE);	// enable INTs, but not START
   }
-  else
+  else {
+    twi_resultReady = false;
     // send start condition
     TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT) | _BV(TWSTA);
+  }
 
   // wait for read operation to complete
-  while(TWI_MRX == twi_state){
+  while(!twi_resultReady){
     continue;
   }
 
-  if (twi_masterBufferIndex < length)
-    length = twi_masterBufferIndex;
+  if (twi_resultLength < length)
+    length = twi_resultLength;
 
-  // copy twi buffer to data
-  for(i = 0; i < length; ++i){
-    data[i] = twi_masterBuffer[i];
-  }
-	
   return length;
 }
 
 /* 
  * Function twi_writeTo
  * Desc     attempts to become twi bus master and write a
- *          series of bytes to a device on the bus
+ *          series of bytes to a device on the bus.  The bytes
+ *          are copied to the twi buffer only when not waiting.
  * Input    address: 7bit i2c device address
  *          data: pointer to byte array
  *          length: number of bytes in array
@@ -192,9 +224,10 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
 uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait, uint8_t sendStop)
 {
   uint8_t i;
+  uint8_t error;
 
   // ensure data will fit into buffer
-  if(TWI_BUFFER_LENGTH < length){
+  if(!wait && TWI_BUFFER_LENGTH < length){
     return 1;
   }
 
@@ -206,14 +239,20 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
   twi_sendStop = sendStop;
   // reset error state (0xFF.. no error occured)
   twi_error = 0xFF;
+  twi_resultReady = false;
 
   // initialize buffer iteration vars
   twi_masterBufferIndex = 0;
   twi_masterBufferLength = length;
   
-  // copy data to twi buffer
-  for(i = 0; i < length; ++i){
-    twi_masterBuffer[i] = data[i];
+  // copy data to twi buffer, unless it's used where it is
+  if(wait){
+    twi_masterData = data;
+  }else{
+    twi_masterData = twi_masterBuffer;
+    for(i = 0; i < length; ++i){
+      twi_masterBuffer[i] = data[i];
+    }
   }
   
   // build sla+w, slave device address + w bit
@@ -239,20 +278,189 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
     TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);	// enable INTs
 
   // wait for write operation to complete
-  while(wait && (TWI_MTX == twi_state)){
+  while(wait && !twi_resultReady){
     continue;
   }
+  error = twi_resultReady ? twi_result : 0xFF;
   
-  if (twi_error == 0xFF)
+  if (error == 0xFF)
     return 0;	// success
-  else if (twi_error == TW_MT_SLA_NACK)
+  else if (error == TW_MT_SLA_NACK)
     return 2;	// error: address send, nack received
-  else if (twi_error == TW_MT_DATA_NACK)
+  else if (error == TW_MT_DATA_NACK)
     return 3;	// error: data send, nack received
   else
     return 4;	// other twi error
 }
 
+/* 
+ * Function twi_latch
+ * Desc     keeps the outcome of the blocking read or write that has just
+ *          ended for the call waiting on it, before the next queued
+ *          transaction reuses twi_error and twi_masterBufferIndex
+ * Input    none
+ * Output   none
+ */
+static void twi_latch(void)
+{
+  twi_result = twi_error;
+  twi_resultLength = twi_masterBufferIndex;
+  twi_resultReady = true;
+}
+
+/* 
+ * Function twi_setup
+ * Desc     readys the master state for the queued transaction at the
+ *          head of the queue, its write part first if it has one
+ * Input    none
+ * Output   none
+ */
+static void twi_setup(void)
+{
+  twi_transaction* t = twi_queueHead;
+
+  twi_queued = true;
+  twi_sendStop = true;
+  twi_error = 0xFF;
+  twi_masterBufferIndex = 0;
+  if(t->txLength || !t->rxLength){
+    twi_state = TWI_MTX;
+    twi_slarw = TW_WRITE | (t->address << 1);
+    twi_masterData = (uint8_t*)t->txData;
+    twi_masterBufferLength = t->txLength;
+  }else{
+    twi_state = TWI_MRX;
+    twi_slarw = TW_READ | (t->address << 1);
+    twi_masterData = t->rxData;
+    twi_masterBufferLength = t->rxLength-1;
+  }
+}
+
+/* 
+ * Function twi_finish
+ * Desc     takes the transaction on the bus off the queue, sets its
+ *          status from twi_error and calls its completion callback
+ * Input    none
+ * Output   none
+ */
+static void twi_finish(void)
+{
+  twi_transaction* t = twi_queueHead;
+
+  twi_queued = false;
+  twi_queueHead = t->next;
+  if(!twi_queueHead){
+    twi_queueTail = 0;
+  }
+
+  if (twi_error == 0xFF)
+    t->status = 0;
+  else if (twi_error == TW_MT_SLA_NACK || twi_error == TW_MR_SLA_NACK)
+    t->status = 2;
+  else if (twi_error == TW_MT_DATA_NACK)
+    t->status = 3;
+  else
+    t->status = 4;
+
+  // the callback may queue another transaction, the bus isn't
+  // given up until it returns
+  if(t->onComplete){
+    t->onComplete(t);
+  }
+}
+
+/* 
+ * Function twi_next
+ * Desc     starts the next queued transaction straight away, or lets go
+ *          of the bus if there is none
+ * Input    sendStop: whether this master still holds the bus and must
+ *          send a stop first
+ * Output   none
+ */
+static void twi_next(uint8_t sendStop)
+{
+  if(twi_queueHead){
+    twi_setup();
+    // the TWI sends the stop and then the start, no need to wait between
+    if(sendStop){
+      TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTO) | _BV(TWSTA);
+    }else{
+      TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+    }
+  }else if(sendStop){
+    twi_stop();
+  }else{
+    twi_releaseBus();
+  }
+}
+
+/* 
+ * Function twi_submit
+ * Desc     queues a transaction and returns without waiting for it.
+ *          Queued transactions follow one another from the interrupt,
+ *          in order, each starting as the last one's stop is sent.
+ *          Blocking reads and writes wait for the queue to empty.
+ * Input    t: transaction, with its address, buffers, lengths and
+ *          callback set
+ * Output   0 .. queued, t->status is TWI_PENDING until it is done
+ *          1 .. t is already queued
+ */
+uint8_t twi_submit(twi_transaction* t)
+{
+  uint8_t oldSREG = SREG;
+  twi_transaction* q;
+
+  cli();
+  for(q = twi_queueHead; q; q = q->next){
+    if(q == t){
+      SREG = oldSREG;
+      return 1;
+    }
+  }
+  t->next = 0;
+  t->status = TWI_PENDING;
+  if(twi_queueTail){
+    twi_queueTail->next = t;
+  }else{
+    twi_queueHead = t;
+  }
+  twi_queueTail = t;
+
+  // otherwise it is started when the bus is given up
+  if(twi_queueHead == t && TWI_READY == twi_state){
+    twi_setup();
+    if (true == twi_inRepStart) {
+      // the start was sent by the last blocking call, see twi_readFrom()
+      twi_inRepStart = false;
+      TWDR = twi_slarw;
+      TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE);
+    }
+    else
+      TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+  }
+  SREG = oldSREG;
+  return 0;
+}
+
+/* 
+ * Function twi_transfer
+ * Desc     runs a transaction to the end, after any already queued.
+ *          As long as the buffers are, in one bus transaction, with
+ *          the data going straight to and from them.
+ * Input    t: transaction, as for twi_submit()
+ * Output   t->status, see twi_writeTo()
+ */
+uint8_t twi_transfer(twi_transaction* t)
+{
+  if(twi_submit(t)){
+    return 4;
+  }
+  while(TWI_PENDING == t->status){
+    continue;
+  }
+  return t->status;
+}
+
 /* 
  * Function twi_transmit
  * Desc     fills slave tx buffer with data
@@ -286,6 +494,106 @@ uint8_t twi_transmit(const uint8_t* data, uint8_t length)
   return 0;
 }
 
+/* 
+ * Function twi_attachSlaveRxStream
+ * Desc     has bytes written to this slave put into a ring buffer as
+ *          they arrive, instead of collected in twi_rxBuffer and handed
+ *          over at the stop.  They are taken out with twi_slaveRead().
+ *          The next byte is only acked while the ring has room for it,
+ *          so a master writing faster than the ring is read gets a NACK.
+ * Input    buffer: the ring, or 0 to go back to twi_rxBuffer
+ *          size: of the ring, rounded down to a power of two up to 256.
+ *                It holds size-1 bytes.
+ *          function: called from the interrupt with the number of bytes
+ *                written when the master ends a transfer, or 0
+ * Output   none
+ */
+void twi_attachSlaveRxStream(uint8_t* buffer, uint16_t size, void (*function)(int))
+{
+  uint8_t oldSREG = SREG;
+  uint16_t n = 2;
+
+  while(n <= size && n <= 256){
+    n <<= 1;
+  }
+  cli();
+  twi_ring = (buffer && size >= 2) ? buffer : 0;
+  twi_ringMask = twi_ring ? (n >> 1) - 1 : 0;
+  twi_ringHead = 0;
+  twi_ringTail = 0;
+  twi_onSlaveStreamEnd = function;
+  SREG = oldSREG;
+}
+
+/* 
+ * Function twi_attachSlaveTxStream
+ * Desc     has the bytes a master reads from this slave asked for one at
+ *          a time, from the interrupt, instead of taken from twi_txBuffer.
+ *          Each is asked for a byte ahead, to know whether to expect an
+ *          ack, so the last one asked for may not be read.
+ * Input    function: given the index of the byte in this transfer,
+ *          returns the byte, or -1 when there are no more.  0 to go
+ *          back to twi_txBuffer.
+ * Output   none
+ */
+void twi_attachSlaveTxStream( int (*function)(uint16_t) )
+{
+  uint8_t oldSREG = SREG;
+
+  // a pointer is two bytes, the interrupt mustn't see half of it
+  cli();
+  twi_onSlaveStreamTransmit = function;
+  SREG = oldSREG;
+}
+
+/* 
+ * Function twi_slaveAvailable
+ * Desc     number of received bytes in the slave receive ring
+ * Input    none
+ * Output   0 to size-1
+ */
+uint8_t twi_slaveAvailable(void)
+{
+  return (twi_ringHead - twi_ringTail) & twi_ringMask;
+}
+
+/* 
+ * Function twi_slaveRead
+ * Desc     takes the next byte out of the slave receive ring.  Safe
+ *          against the interrupt without disabling it, as long as only
+ *          one caller reads.
+ * Input    none
+ * Output   the byte, or -1 if the ring is empty
+ */
+int twi_slaveRead(void)
+{
+  uint8_t tail = twi_ringTail;
+  int b;
+
+  if(tail == twi_ringHead){
+    return -1;
+  }
+  b = twi_ring[tail];
+  twi_ringTail = (tail + 1) & twi_ringMask;
+  return b;
+}
+
+/* 
+ * Function twi_slavePeek
+ * Desc     the next byte in the slave receive ring, left there
+ * Input    none
+ * Output   the byte, or -1 if the ring is empty
+ */
+int twi_slavePeek(void)
+{
+  uint8_t tail = twi_ringTail;
+
+  if(tail == twi_ringHead){
+    return -1;
+  }
+  return twi_ring[tail];
+}
+
 /* 
  * Function twi_attachSlaveRxEvent
  * Desc     sets function called before a slave read operation
@@ -377,11 +685,23 @@ SIGNAL(TWI_vect)
       // if there is data to send, send it, otherwise stop 
       if(twi_masterBufferIndex < twi_masterBufferLength){
         // copy data to output register and ack
-        TWDR = twi_masterBuffer[twi_masterBufferIndex++];
+        TWDR = twi_masterData[twi_masterBufferIndex++];
         twi_reply(1);
+      }else if(twi_queued && twi_queueHead->rxLength){
+        // go on to the read part after a repeated start
+        twi_state = TWI_MRX;
+        twi_slarw = TW_READ | (twi_queueHead->address << 1);
+        twi_masterData = twi_queueHead->rxData;
+        twi_masterBufferIndex = 0;
+        twi_masterBufferLength = twi_queueHead->rxLength-1;
+        TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+      }else if(twi_queued){
+        twi_finish();
+        twi_next(true);
       }else{
+        twi_latch();
 	if (twi_sendStop)
-          twi_stop();
+          twi_next(true);
 	else {
 	  twi_inRepStart = true;	// we're gonna send the START
 	  // don't enable the interrupt. We'll generate the start, but we 
@@ -394,21 +714,33 @@ SIGNAL(TWI_vect)
       break;
     case TW_MT_SLA_NACK:  // address sent, nack received
       twi_error = TW_MT_SLA_NACK;
-      twi_stop();
+      if(twi_queued)
+        twi_finish();
+      else
+        twi_latch();
+      twi_next(true);
       break;
     case TW_MT_DATA_NACK: // data sent, nack received
       twi_error = TW_MT_DATA_NACK;
-      twi_stop();
+      if(twi_queued)
+        twi_finish();
+      else
+        twi_latch();
+      twi_next(true);
       break;
     case TW_MT_ARB_LOST: // lost bus arbitration
       twi_error = TW_MT_ARB_LOST;
-      twi_releaseBus();
+      if(twi_queued)
+        twi_finish();
+      else
+        twi_latch();
+      twi_next(false);
       break;
 
     // Master Receiver
     case TW_MR_DATA_ACK: // data received, ack sent
       // put byte into buffer
-      twi_masterBuffer[twi_masterBufferIndex++] = TWDR;
+      twi_masterData[twi_masterBufferIndex++] = TWDR;
     case TW_MR_SLA_ACK:  // address sent, ack received
       // ack if more bytes are expected, otherwise nack
       if(twi_masterBufferIndex < twi_masterBufferLength){
@@ -419,9 +751,15 @@ SIGNAL(TWI_vect)
       break;
     case TW_MR_DATA_NACK: // data received, nack sent
       // put final byte into buffer
-      twi_masterBuffer[twi_masterBufferIndex++] = TWDR;
+      twi_masterData[twi_masterBufferIndex++] = TWDR;
+	if (twi_queued) {
+	  twi_finish();
+	  twi_next(true);
+	  break;
+	}
+	twi_latch();
 	if (twi_sendStop)
-          twi_stop();
+          twi_next(true);
 	else {
 	  twi_inRepStart = true;	// we're gonna send the START
 	  // don't enable the interrupt. We'll generate the start, but we 
@@ -432,25 +770,45 @@ SIGNAL(TWI_vect)
 	}    
 	break;
     case TW_MR_SLA_NACK: // address sent, nack received
-      twi_stop();
+      if(twi_queued){
+        twi_error = TW_MR_SLA_NACK;
+        twi_finish();
+      }else{
+        twi_latch();
+      }
+      twi_next(true);
       break;
     // TW_MR_ARB_LOST handled by TW_MT_ARB_LOST case
 
     // Slave Receiver
-    case TW_SR_SLA_ACK:   // addressed, returned ack
-    case TW_SR_GCALL_ACK: // addressed generally, returned ack
     case TW_SR_ARB_LOST_SLA_ACK:   // lost arbitration, returned ack
     case TW_SR_ARB_LOST_GCALL_ACK: // lost arbitration, returned ack
+      if(twi_queued){
+        // the rest of the queue starts once the master is done with us
+        twi_error = TW_MT_ARB_LOST;
+        twi_finish();
+      }else{
+        twi_latch();
+      }
+    case TW_SR_SLA_ACK:   // addressed, returned ack
+    case TW_SR_GCALL_ACK: // addressed generally, returned ack
       // enter slave receiver mode
       twi_state = TWI_SRX;
       // indicate that rx buffer can be overwritten and ack
       twi_rxBufferIndex = 0;
-      twi_reply(1);
+      twi_slaveCount = 0;
+      // a stream only acks what the ring has room for
+      twi_reply(!twi_ring || ((twi_ringHead + 1) & twi_ringMask) != twi_ringTail);
       break;
     case TW_SR_DATA_ACK:       // data received, returned ack
     case TW_SR_GCALL_DATA_ACK: // data received generally, returned ack
-      // if there is still room in the rx buffer
-      if(twi_rxBufferIndex < TWI_BUFFER_LENGTH){
+      if(twi_ring){
+        // it was acked, so there is room for it
+        twi_ring[twi_ringHead] = TWDR;
+        twi_ringHead = (twi_ringHead + 1) & twi_ringMask;
+        twi_slaveCount++;
+        twi_reply(((twi_ringHead + 1) & twi_ringMask) != twi_ringTail);
+      }else if(twi_rxBufferIndex < TWI_BUFFER_LENGTH){
         // put byte in buffer and ack
         twi_rxBuffer[twi_rxBufferIndex++] = TWDR;
         twi_reply(1);
@@ -460,6 +818,15 @@ SIGNAL(TWI_vect)
       }
       break;
     case TW_SR_STOP: // stop or repeated start condition received
+      if(twi_ring){
+        // the bytes are in the ring already
+        twi_stop();
+        if(twi_onSlaveStreamEnd){
+          twi_onSlaveStreamEnd(twi_slaveCount);
+        }
+        twi_next(false);
+        break;
+      }
       // put a null char after data if there's room
       if(twi_rxBufferIndex < TWI_BUFFER_LENGTH){
         twi_rxBuffer[twi_rxBufferIndex] = '\0';
@@ -470,34 +837,66 @@ SIGNAL(TWI_vect)
       twi_onSlaveReceive(twi_rxBuffer, twi_rxBufferIndex);
       // since we submit rx buffer to "wire" library, we can reset it
       twi_rxBufferIndex = 0;
-      // ack future responses and leave slave receiver state
-      twi_releaseBus();
+      // ack future responses and leave slave receiver state, or go
+      // back to the queued transactions
+      twi_next(false);
       break;
     case TW_SR_DATA_NACK:       // data received, returned nack
     case TW_SR_GCALL_DATA_NACK: // data received generally, returned nack
-      // nack back at master
-      twi_reply(0);
+      // the master stops after the nack, with no stop interrupt for
+      // this slave, so the transfer ends here
+      if(twi_ring && twi_onSlaveStreamEnd){
+        twi_onSlaveStreamEnd(twi_slaveCount);
+      }
+      // listen for the address again, or go back to the queued
+      // transactions
+      twi_next(false);
       break;
     
     // Slave Transmitter
-    case TW_ST_SLA_ACK:          // addressed, returned ack
     case TW_ST_ARB_LOST_SLA_ACK: // arbitration lost, returned ack
+      if(twi_queued){
+        twi_error = TW_MT_ARB_LOST;
+        twi_finish();
+      }else{
+        twi_latch();
+      }
+    case TW_ST_SLA_ACK:          // addressed, returned ack
       // enter slave transmitter mode
       twi_state = TWI_STX;
       // ready the tx buffer index for iteration
       twi_txBufferIndex = 0;
       // set tx buffer length to be zero, to verify if user changes it
       twi_txBufferLength = 0;
-      // request for txBuffer to be filled and length to be set
-      // note: user must call twi_transmit(bytes, length) to do this
-      twi_onSlaveTransmit();
-      // if they didn't change buffer & length, initialize it
-      if(0 == twi_txBufferLength){
-        twi_txBufferLength = 1;
-        twi_txBuffer[0] = 0x00;
+      if(twi_onSlaveStreamTransmit){
+        // ask for the first byte
+        twi_slaveCount = 0;
+        twi_slaveNext = twi_onSlaveStreamTransmit(0);
+        if(twi_slaveNext < 0){
+          // nothing to send, a single 0 as below
+          TWDR = 0x00;
+          twi_reply(0);
+          break;
+        }
+      }else{
+        // request for txBuffer to be filled and length to be set
+        // note: user must call twi_transmit(bytes, length) to do this
+        twi_onSlaveTransmit();
+        // if they didn't change buffer & length, initialize it
+        if(0 == twi_txBufferLength){
+          twi_txBufferLength = 1;
+          twi_txBuffer[0] = 0x00;
+        }
       }
       // transmit first byte from buffer, fall
     case TW_ST_DATA_ACK: // byte sent, ack returned
+      if(twi_onSlaveStreamTransmit){
+        // send the byte asked for last time, and ask for the one after
+        TWDR = twi_slaveNext;
+        twi_slaveNext = twi_onSlaveStreamTransmit(++twi_slaveCount);
+        twi_reply(twi_slaveNext >= 0);
+        break;
+      }
       // copy data to output register
       TWDR = twi_txBuffer[twi_txBufferIndex++];
       // if there is more to send, ack, otherwise nack
@@ -509,10 +908,9 @@ SIGNAL(TWI_vect)
       break;
     case TW_ST_DATA_NACK: // received nack, we are done 
     case TW_ST_LAST_DATA: // received ack, but we are done already!
-      // ack future responses
-      twi_reply(1);
-      // leave slave receiver state
-      twi_state = TWI_READY;
+      // ack future responses and leave slave transmitter state, or go
+      // back to the queued transactions
+      twi_next(false);
       break;
 
     // All
@@ -520,7 +918,11 @@ SIGNAL(TWI_vect)
       break;
     case TW_BUS_ERROR: // bus error, illegal stop/start
       twi_error = TW_BUS_ERROR;
-      twi_stop();
+      if(twi_queued)
+        twi_finish();
+      else
+        twi_latch();
+      twi_next(true);
       break;
   }
 }
@@ -14,38 +14,203 @@
 
 #include <SD.h>
 
-/* for debugging file open/close leaks
-   uint8_t nfilecount=0;
-*/
+// Open files live in this pool instead of the heap.  A slot is free when
+// no File handle refers to it.
+static SdFile filePool[SD_FILE_POOL_SIZE];
+static uint8_t fileRefs[SD_FILE_POOL_SIZE];   // File handles per slot
+static uint8_t poolCount;                     // slots in use
+static uint8_t poolMax;                       // most slots ever in use
+static uint16_t poolRefused;                  // opens lost to a full pool
+
+#if SD_WRITE_BEHIND
+// Write-behind state.  Only one file may use it since the card has a
+// single multiple block write in progress.
+static SdFile *wbFile;                // file in write-behind mode
+static uint8_t wbBuf[2][512];         // buffer being filled and block to send
+static uint8_t wbFill;                // index of the buffer being filled
+static uint16_t wbCount;              // bytes in the buffer being filled
+static uint8_t wbPending;             // the other buffer waits to be sent
+static uint8_t wbBusy;                // card is programming the last block
+static uint32_t wbSent;               // micros() when the last block was sent
+static uint32_t wbWriteTime;          // micros spent in write()
+static uint32_t wbWaitTime;           // part of wbWriteTime waiting for card
+static uint32_t wbBusyTime;           // micros the card was seen busy
+
+// move the card on one step without waiting, false for an I/O error
+static boolean wbStep(void) {
+  if (wbBusy) {
+    if (SdVolume::blockDevice()->isBusy()) return true;
+    wbBusy = false;
+    wbBusyTime += micros() - wbSent;
+  }
+  if (wbPending) {
+    if (!wbFile->writeLog(wbBuf[wbFill ^ 1])) return false;
+    wbPending = false;
+    wbBusy = true;
+    wbSent = micros();
+  }
+  return true;
+}
+
+// write all buffered data to the file, the mode stays on
+static boolean wbDrain(void) {
+  while (wbPending || wbBusy) {
+    if (!wbStep()) return false;
+  }
+  if (wbCount) {
+    // a partial block goes through the cache, it is rewritten with the
+    // rest of the block by the next writeLog()
+    if (wbFile->write(wbBuf[wbFill], wbCount) != wbCount) return false;
+    if (!wbFile->seekCur(-(int32_t)wbCount)) return false;
+  }
+  return wbFile->sync();
+}
+
+// end write-behind if f is using it
+static boolean wbEnd(SdFile *f) {
+  if (f != wbFile) return true;
+  boolean rtn = wbDrain();
+  wbFile = 0;
+  return rtn;
+}
+#endif  // SD_WRITE_BEHIND
 
 File::File(SdFile f, const char *n) {
-  // oh man you are kidding me, new() doesnt exist? Ok we do it by hand!
-  _file = (SdFile *)malloc(sizeof(SdFile)); 
-  if (_file) {
-    memcpy(_file, &f, sizeof(SdFile));
-    
-    strncpy(_name, n, 12);
-    _name[12] = 0;
-    
-    /* for debugging file open/close leaks
-       nfilecount++;
-       Serial.print("Created \"");
-       Serial.print(n);
-       Serial.print("\": ");
-       Serial.println(nfilecount, DEC);
-    */
+  _file = 0;
+  _name[0] = 0;
+  for (uint8_t i = 0; i < SD_FILE_POOL_SIZE; i++) {
+    if (fileRefs[i] == 0) {
+      fileRefs[i] = 1;
+      _file = &filePool[i];
+      *_file = f;
+      strncpy(_name, n, 12);
+      _name[12] = 0;
+      if (++poolCount > poolMax) poolMax = poolCount;
+      return;
+    }
   }
+  // every slot is in use, the file is left as it was opened
+  poolRefused++;
 }
 
 File::File(void) {
   _file = 0;
   _name[0] = 0;
-  //Serial.print("Created empty file object");
 }
 
+// copies share the slot, it is freed when the last one goes away
+File::File(const File &f) : Stream(f) {
+  _file = f._file;
+  if (_file) fileRefs[_file - filePool]++;
+  memcpy(_name, f._name, sizeof(_name));
+}
+
+#if __cplusplus >= 201103L
+File::File(File &&f) : Stream(f) {
+  _file = f._file;
+  f._file = 0;
+  memcpy(_name, f._name, sizeof(_name));
+}
+#endif
+
 File::~File(void) {
-  //  Serial.print("Deleted file object");
+  release();
+}
+
+File &File::operator=(const File &f) {
+  if (this != &f) {
+    // take the new reference first in case both refer to the same slot
+    if (f._file) fileRefs[f._file - filePool]++;
+    release();
+    Stream::operator=(f);
+    _file = f._file;
+    memcpy(_name, f._name, sizeof(_name));
+  }
+  return *this;
+}
+
+#if __cplusplus >= 201103L
+File &File::operator=(File &&f) {
+  if (this != &f) {
+    release();
+    Stream::operator=(f);
+    _file = f._file;
+    f._file = 0;
+    memcpy(_name, f._name, sizeof(_name));
+  }
+  return *this;
+}
+#endif
+
+// drop this handle's reference, the last one closes the file
+void File::release(void) {
+  if (_file) {
+    uint8_t i = _file - filePool;
+    if (--fileRefs[i] == 0) {
+#if SD_WRITE_BEHIND
+      wbEnd(_file);
+#endif
+      if (_file->isOpen()) _file->close();
+      poolCount--;
+    }
+    _file = 0;
+  }
+}
+
+uint8_t File::poolInUse(void) {
+  return poolCount;
+}
+
+uint8_t File::poolPeak(void) {
+  return poolMax;
+}
+
+uint16_t File::poolFailures(void) {
+  return poolRefused;
+}
+
+#if SD_WRITE_BEHIND
+// start buffering appends, the file must have contiguous space reserved
+boolean File::beginWriteBehind(void) {
+  uint32_t bgnBlock, endBlock;
+  if (!_file || wbFile || !_file->isFile()) return false;
+  if (!_file->contiguousRange(&bgnBlock, &endBlock)) return false;
+
+  // appends start at the end, reload a partial last block
+  uint32_t pos = _file->fileSize();
+  wbCount = pos & 0X1FF;
+  if (!_file->seekSet(pos - wbCount)) return false;
+  if (wbCount) {
+    if (_file->read(wbBuf[0], wbCount) != wbCount) return false;
+    if (!_file->seekSet(pos - wbCount)) return false;
+  }
+  wbFill = 0;
+  wbPending = false;
+  wbBusy = false;
+  wbFile = _file;
+  return true;
+}
+
+void File::endWriteBehind(void) {
+  if (_file && !wbEnd(_file)) setWriteError();
+}
+
+// call often so the next block is sent as soon as the card is ready
+void File::poll(void) {
+  if (_file && _file == wbFile && !wbStep()) setWriteError();
+}
+
+void File::writeBehindStats(uint32_t *writeMicros, uint32_t *waitMicros,
+                            uint32_t *busyMicros) {
+  *writeMicros = wbWriteTime;
+  *waitMicros = wbWaitTime;
+  *busyMicros = wbBusyTime;
+}
+
+void File::writeBehindStatsClear(void) {
+  wbWriteTime = wbWaitTime = wbBusyTime = 0;
 }
+#endif  // SD_WRITE_BEHIND
 
 // returns a pointer to the file name
 char *File::name(void) {
@@ -68,6 +233,42 @@ size_t File::write(const uint8_t *buf, size_t size) {
     setWriteError();
     return 0;
   }
+#if SD_WRITE_BEHIND
+  if (_file == wbFile) {
+    uint32_t t0 = micros();
+    for (t = 0; t < size;) {
+      uint16_t n = 512 - wbCount;
+      if (n > size - t) n = size - t;
+      memcpy(wbBuf[wbFill] + wbCount, buf + t, n);
+      wbCount += n;
+      t += n;
+      if (wbCount < 512) break;
+
+      // both buffers full, wait for the card
+      if (wbPending) {
+        uint32_t t1 = micros();
+        while (wbPending) {
+          if (!wbStep()) break;
+        }
+        wbWaitTime += micros() - t1;
+      }
+      // the t bytes copied so far are buffered, report a short count
+      if (wbPending) {
+        setWriteError();
+        break;
+      }
+      wbPending = true;
+      wbFill ^= 1;
+      wbCount = 0;
+      if (!wbStep()) {
+        setWriteError();
+        break;
+      }
+    }
+    wbWriteTime += micros() - t0;
+    return t;
+  }
+#endif  // SD_WRITE_BEHIND
   _file->clearWriteError();
   t = _file->write(buf, size);
   if (_file->getWriteError()) {
@@ -77,9 +278,28 @@ size_t File::write(const uint8_t *buf, size_t size) {
   return t;
 }
 
+// appends one 512 byte block to a file made by SD.createLog()
+boolean File::writeLog(const uint8_t *block) {
+  if (!_file) {
+    setWriteError();
+    return false;
+  }
+#if SD_WRITE_BEHIND
+  wbEnd(_file);
+#endif
+  if (!_file->writeLog(block)) {
+    setWriteError();
+    return false;
+  }
+  return true;
+}
+
 int File::peek() {
   if (! _file) 
     return 0;
+#if SD_WRITE_BEHIND
+  wbEnd(_file);
+#endif
 
   int c = _file->read();
   if (c != -1) _file->seekCur(-1);
@@ -87,16 +307,22 @@ int File::peek() {
 }
 
 int File::read() {
-  if (_file) 
-    return _file->read();
-  return -1;
+  if (! _file) 
+    return -1;
+#if SD_WRITE_BEHIND
+  wbEnd(_file);
+#endif
+  return _file->read();
 }
 
 // buffered read for more efficient, high speed reading
 int File::read(void *buf, uint16_t nbyte) {
-  if (_file) 
-    return _file->read(buf, nbyte);
-  return 0;
+  if (! _file) 
+    return 0;
+#if SD_WRITE_BEHIND
+  wbEnd(_file);
+#endif
+  return _file->read(buf, nbyte);
 }
 
 int File::available() {
@@ -108,37 +334,52 @@ int File::available() {
 }
 
 void File::flush() {
-  if (_file)
-    _file->sync();
+  if (! _file) return;
+#if SD_WRITE_BEHIND
+  if (_file == wbFile) {
+    if (!wbDrain()) setWriteError();
+    return;
+  }
+#endif
+  _file->sync();
 }
 
 boolean File::seek(uint32_t pos) {
   if (! _file) return false;
+#if SD_WRITE_BEHIND
+  wbEnd(_file);
+#endif
 
   return _file->seekSet(pos);
 }
 
 uint32_t File::position() {
   if (! _file) return -1;
+#if SD_WRITE_BEHIND
+  // buffered data follows the file position
+  if (_file == wbFile)
+    return _file->curPosition() + (wbPending ? 512 : 0) + wbCount;
+#endif
   return _file->curPosition();
 }
 
 uint32_t File::size() {
   if (! _file) return 0;
+#if SD_WRITE_BEHIND
+  if (_file == wbFile && position() > _file->fileSize()) return position();
+#endif
   return _file->fileSize();
 }
 
+// Saves the file and drops this handle. Copies of the handle share the
+// open file, which is closed when the last of them is closed or destroyed.
 void File::close() {
   if (_file) {
-    _file->close();
-    free(_file); 
-    _file = 0;
-
-    /* for debugging file open/close leaks
-    nfilecount--;
-    Serial.print("Deleted ");
-    Serial.println(nfilecount, DEC);
-    */
+#if SD_WRITE_BEHIND
+    if (!wbEnd(_file)) setWriteError();
+#endif
+    if (_file->isOpen() && !_file->sync()) setWriteError();
+    release();
   }
 }
 
@@ -105,6 +105,7 @@
 //                                                            F U N C T I O N S
 //-----------------------------------------------------------------------------
 //        getNextPathComponent()
+//        pathHash()
 
 //-----------------------------------------------------------------------------
 //                                                        G L O B A L   D A T A
@@ -188,6 +189,67 @@ bool getNextPathComponent (IN char * cpPath, IN OUT unsigned int * ipOffset, OUT
      return (cpPath [iOffset] != 0x00) ;
 }
 
+#if SD_PATH_CACHE_SIZE
+//-----------------------------------------------------------------------------
+//                                                                     pathHash
+//-----------------------------------------------------------------------------
+/*
+ *   pathHash() returns a 32-bit FNV-1a hash of the first 'iLength' characters
+ *   of 'cpPath'. Letters are folded to upper case, leading and trailing 
+ *   separators are ignored and a run of separators counts as one, so each 
+ *   spelling of a path that opens the same file gives the same hash. The 
+ *   number of characters hashed is returned via 'bpCount'. Zero is never 
+ *   returned so that it can mark an unused cache entry.
+ *
+ *   A second, unrelated 16-bit hash of the same characters is returned via 
+ *   'wpCheck'. Two paths that differ only in a parent directory, such as 
+ *   /A/DATA.CSV and /B/DATA.CSV, have the same last component, so a cache 
+ *   hit is trusted only if the length and both hashes match.
+ */
+uint32_t pathHash (IN const char * cpPath, IN int iLength, OUT uint8_t * bpCount, OUT uint16_t * wpCheck)
+{
+     boolean   bfSeparator ;
+     char      cChar ;
+     int       iIndex ;
+     uint8_t   bCount ;
+     uint16_t  wCheck ;
+     uint32_t  dwHash ;
+
+// Init
+     bfSeparator = false ;
+     bCount      = 0 ;
+     wCheck      = 5381 ;
+     dwHash      = 2166136261UL ;
+// Hash each character of the path
+     for (iIndex = 0 ; iIndex < iLength ; iIndex ++)
+     {
+          cChar = cpPath [iIndex] ;
+          if (cChar == '/')
+          {
+               bfSeparator = true ;
+               continue ;
+          }
+     // Hash a single separator between components
+          if (bfSeparator && bCount)
+          {
+               dwHash = (dwHash ^ '/') * 16777619UL ;
+               wCheck = (wCheck << 5) + wCheck + '/' ;
+               bCount ++ ;
+          }
+          bfSeparator = false ;
+     // Short names are stored in upper case
+          if (cChar >= 'a' && cChar <= 'z')
+               cChar -= 'a' - 'A' ;
+          dwHash = (dwHash ^ (uint8_t) cChar) * 16777619UL ;
+          wCheck = (wCheck << 5) + wCheck + (uint8_t) cChar ;
+          bCount ++ ;
+     }
+     *bpCount = bCount ;
+     *wpCheck = wCheck ;
+     return (dwHash ? dwHash : 1) ;
+}
+#endif
+
 //-----------------------------------------------------------------------------
 //                                                                     walkPath
 //-----------------------------------------------------------------------------
@@ -293,6 +355,11 @@ boolean callback_pathExists (SdFile& parentDir, char *filePathComponent, boolean
   boolean exists = child.open(parentDir, filePathComponent, O_RDONLY);
   
   if (exists) {
+#if SD_PATH_CACHE_SIZE
+     // remember where the whole path passed by 'exists' was found
+     if (isLastComponent && object)
+          SD.pathCacheAdd((char *) object, strlen((char *) object), child);
+#endif
      child.close(); 
   }
   
@@ -391,16 +458,146 @@ boolean SDClass::begin (uint8_t csPin)
     Return true if initialization succeeds, false otherwise.
 
    */
+#if SD_PATH_CACHE_SIZE
+  // a different card may have been inserted
+  pathCacheClear();
+  pathHits = 0;
+  pathMisses = 0;
+#endif
   return card.init(SPI_HALF_SPEED, csPin) &&
          volume.init(card) &&
          root.openRoot(volume);
 }
 
+//=============================================================================
+//                                                                       .begin
+//-----------------------------------------------------------------------------
+boolean SDClass::begin (SdBlockDevice & device)
+{
+  /*
+
+    Mounts the FAT volume on 'device' instead of the SPI card.
+
+    Return true if initialization succeeds, false otherwise.
+
+   */
+#if SD_PATH_CACHE_SIZE
+  pathCacheClear();
+  pathHits = 0;
+  pathMisses = 0;
+#endif
+  root.close();
+  return volume.init(&device) &&
+         root.openRoot(volume);
+}
+
+#if SD_PATH_CACHE_SIZE
+//=============================================================================
+//                                                              .pathCacheClear
+//-----------------------------------------------------------------------------
+// Forget all cached paths. Used when entries may have moved or been removed.
+void SDClass::pathCacheClear (void)
+{
+     uint8_t   bIndex ;
+
+     for (bIndex = 0 ; bIndex < SD_PATH_CACHE_SIZE ; bIndex ++)
+          pathCache [bIndex].hash = 0 ;
+     pathNext = 0 ;
+}
+
+//=============================================================================
+//                                                               .pathCacheOpen
+//-----------------------------------------------------------------------------
+/*
+ *   Open the file or directory named by the first 'length' characters of
+ *   'filepath' from a cached directory entry. Returns false if the path is
+ *   not cached or the entry no longer holds the file, in which case the
+ *   caller must search for the path.
+ */
+boolean SDClass::pathCacheOpen (SdFile & file, const char * filepath, int length, uint8_t mode)
+{
+     const char *   cpName ;
+     uint8_t   bCount ;
+     uint8_t   bIndex ;
+     uint16_t  wCheck ;
+     uint32_t  dwHash ;
+
+     dwHash = pathHash (filepath, length, & bCount, & wCheck) ;
+// The root directory is always open
+     if (bCount == 0)
+          return false ;
+// Find the last component, which is checked against the directory entry
+     cpName = filepath + length ;
+     while (cpName > filepath && cpName [-1] != '/')
+          cpName -- ;
+// Search cache
+     for (bIndex = 0 ; bIndex < SD_PATH_CACHE_SIZE ; bIndex ++)
+     {
+          if (pathCache [bIndex].hash != dwHash || pathCache [bIndex].length != bCount
+              || pathCache [bIndex].check != wCheck)
+               continue ;
+          if (file.openEntry (& volume, pathCache [bIndex].dirBlock, pathCache [bIndex].dirIndex, cpName, mode))
+          {
+               pathHits ++ ;
+               return true ;
+          }
+          break ;
+     }
+     pathMisses ++ ;
+     return false ;
+}
+
+//=============================================================================
+//                                                                .pathCacheAdd
+//-----------------------------------------------------------------------------
+// Remember the directory entry of an open file found by the given path.
+void SDClass::pathCacheAdd (const char * filepath, int length, SdFile & file)
+{
+     uint8_t   bCount ;
+     uint8_t   bIndex ;
+     uint16_t  wCheck ;
+     uint32_t  dwHash ;
+
+     dwHash = pathHash (filepath, length, & bCount, & wCheck) ;
+     if (bCount == 0 || file.isRoot ())
+          return ;
+// Replace an old entry for the same path, or the next entry in turn
+     for (bIndex = 0 ; bIndex < SD_PATH_CACHE_SIZE ; bIndex ++)
+     {
+          if (pathCache [bIndex].hash == dwHash && pathCache [bIndex].length == bCount
+              && pathCache [bIndex].check == wCheck)
+               break ;
+     }
+     if (bIndex == SD_PATH_CACHE_SIZE)
+     {
+          bIndex = pathNext ;
+          pathNext = (pathNext + 1) % SD_PATH_CACHE_SIZE ;
+     }
+     pathCache [bIndex].hash     = dwHash ;
+     pathCache [bIndex].dirBlock = file.dirBlock () ;
+     pathCache [bIndex].dirIndex = file.dirIndex () ;
+     pathCache [bIndex].length   = bCount ;
+     pathCache [bIndex].check    = wCheck ;
+}
+#endif
+
 //=============================================================================
 //                                                                .getParentDir
 //-----------------------------------------------------------------------------
 // this little helper is used to traverse paths
 SdFile SDClass::getParentDir (const char *filepath, int *index) {
+#if SD_PATH_CACHE_SIZE
+  // try the cache for the whole parent path first
+  const char *last = strrchr(filepath, '/');
+  if (last) {
+    SdFile dir;
+    if (pathCacheOpen(dir, filepath, (int)(last - filepath), O_READ)) {
+      *index = (int)(last + 1 - filepath);
+      return dir;
+    }
+  }
+#endif
+
   // get parent directory
   SdFile d1 = root; // start with the mostparent, root!
   SdFile d2;
@@ -438,6 +635,9 @@ SdFile SDClass::getParentDir (const char *filepath, int *index) {
       // failed to open one of the subdirectories
       return SdFile();
     }
+#if SD_PATH_CACHE_SIZE
+    pathCacheAdd(origpath, (int)(filepath + idx - origpath), *subdir);
+#endif
     // move forward to the next subdirectory
     filepath += idx;
 
@@ -484,6 +684,20 @@ File SDClass::open(const char *filepath, uint8_t mode) {
 
   int pathidx;
 
+#if SD_PATH_CACHE_SIZE
+  const char *origpath = filepath;
+  {
+    // a cached path is opened without searching any directory
+    SdFile file;
+    if (pathCacheOpen(file, filepath, strlen(filepath), mode)) {
+      const char *name = strrchr(filepath, '/');
+      if (mode & (O_APPEND | O_WRITE)) 
+        file.seekSet(file.fileSize());
+      return File(file, name ? name + 1 : filepath);
+    }
+  }
+#endif
+
   // do the interative search
   SdFile parentdir = getParentDir(filepath, &pathidx);
   // no more subdirs!
@@ -516,12 +730,65 @@ File SDClass::open(const char *filepath, uint8_t mode) {
     // close the parent
     parentdir.close();
   }
+#if SD_PATH_CACHE_SIZE
+  pathCacheAdd(origpath, strlen(origpath), file);
+#endif
 
   if (mode & (O_APPEND | O_WRITE)) 
     file.seekSet(file.fileSize());
   return File(file, filepath);
 }
 
+//=============================================================================
+//                                                                   .createLog
+//-----------------------------------------------------------------------------
+File SDClass::createLog(const char *filepath, uint32_t size) {
+  /*
+
+     Create a new file with 'size' bytes of contiguous space reserved
+     for logging.
+
+     The file starts with zero length. Each call to File::writeLog()
+     appends a 512 byte block to the reserved space without updating the
+     FAT, so the time taken by each append is bounded. The new file size
+     is written to the directory entry when the file is flushed or closed.
+     After a power cut before that, the card holds a zero length file with
+     clusters allocated, which a disk check reports as a lost chain;
+     SD.remove() the file to free them.
+
+     Fails if the file already exists or there is not enough contiguous
+     free space on the card.
+
+   */
+
+  int pathidx;
+
+  SdFile parentdir = getParentDir(filepath, &pathidx);
+
+  filepath += pathidx;
+
+  // failed to open a subdir, or no file name was given
+  if (!parentdir.isOpen() || ! filepath[0])
+    return File();
+
+  SdFile file;
+
+  // there is a special case for the Root directory since its a static dir
+  if (parentdir.isRoot()) {
+    if ( ! file.createLog(&SD.root, filepath, size)) {
+      return File();
+    }
+  } else {
+    boolean created = file.createLog(&parentdir, filepath, size);
+    // close the parent
+    parentdir.close();
+    if ( ! created) {
+      return File();
+    }
+  }
+  return File(file, filepath);
+}
+
 /*
 File SDClass::open(char *filepath, uint8_t mode) {
   //
@@ -578,7 +845,17 @@ boolean SDClass::exists(char *filepath)
      Returns true if the supplied file path exists.
 
    */
+#if SD_PATH_CACHE_SIZE
+  SdFile file;
+  if (pathCacheOpen(file, filepath, strlen(filepath), O_READ)) {
+    file.close();
+    return true;
+  }
+  // the callback caches the location of the whole path
+  return walkPath(filepath, root, callback_pathExists, filepath);
+#else
   return walkPath(filepath, root, callback_pathExists);
+#endif
 }
 
 
@@ -604,6 +881,9 @@ boolean SDClass::mkdir(char *filepath) {
     A rough equivalent to 'mkdir -p'.
   
    */
+#if SD_PATH_CACHE_SIZE
+  pathCacheClear();
+#endif
   return walkPath(filepath, root, callback_makeDirPath);
 }
 
@@ -618,6 +898,9 @@ boolean SDClass::rmdir(char *filepath) {
     A rough equivalent to 'mkdir -p'.
   
    */
+#if SD_PATH_CACHE_SIZE
+  pathCacheClear();
+#endif
   return walkPath(filepath, root, callback_rmdir);
 }
 
@@ -626,6 +909,9 @@ boolean SDClass::rmdir(char *filepath) {
 //-----------------------------------------------------------------------------
 boolean SDClass::remove(char *filepath)
 {
+#if SD_PATH_CACHE_SIZE
+  pathCacheClear();
+#endif
   return walkPath(filepath, root, callback_remove);
 }
 
@@ -666,7 +952,8 @@ File File::openNextFile (uint8_t mode)
     //Serial.print("try to open file ");
     //Serial.println(name);
 
-    if (f.open(_file, name, mode)) {
+    // open by entry number, the entry was just read so no search is needed
+    if (f.open(_file, (uint16_t) (_file->curPosition() / 32 - 1), mode)) {
       //Serial.println("OK!");
       return File(f, name);    
     } else {
@@ -38,6 +38,48 @@
 #include <utility/SdFatUtil.h>
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - -  Compile-Time Options
+/*
+ *   SD_PATH_CACHE_SIZE sets the number of paths remembered by the path 
+ *   lookup cache. A path found in the cache is opened from its directory 
+ *   entry without searching each directory from the root. Each entry uses 
+ *   12 bytes of RAM. Set to zero to disable the cache.
+ */
+#ifndef   SD_PATH_CACHE_SIZE
+#if defined (RAMEND) && RAMEND > 0X8FF
+#define   SD_PATH_CACHE_SIZE  8
+#else
+#define   SD_PATH_CACHE_SIZE  4
+#endif
+#endif
+
+/*
+ *   SD_FILE_POOL_SIZE sets the number of files that may be open at the same 
+ *   time. Each File handle refers to a slot in a static pool of SdFile 
+ *   objects, so opening and closing files never uses the heap. Copies of a 
+ *   File handle share its slot. close() saves the file and drops one handle;
+ *   the slot is returned to the pool when the last handle that refers to it 
+ *   is closed or destroyed.
+ */
+#ifndef   SD_FILE_POOL_SIZE
+#if defined (RAMEND) && RAMEND > 0X8FF
+#define   SD_FILE_POOL_SIZE   8
+#else
+#define   SD_FILE_POOL_SIZE   4
+#endif
+#endif
+
+/*
+ *   SD_WRITE_BEHIND enables File::beginWriteBehind(). Appends to one file 
+ *   are then copied into two 512 byte buffers; while one fills, the other 
+ *   is sent to the card and File::poll() checks when the card has finished 
+ *   programming it, so write() only waits when both buffers are full. 
+ *   Other files and SPI devices may be used in between; the card is 
+ *   released after each block and the stream restarts after any other 
+ *   access.  Uses 1K of RAM, so it is off by default.
+ */
+#ifndef   SD_WRITE_BEHIND
+#define   SD_WRITE_BEHIND     0
+#endif
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Manifest Constants
 #define   FILE_READ      O_READ
@@ -46,6 +88,17 @@
 //-----------------------------------------------------------------------------
 //                                                          S T R U C T U R E S
 //-----------------------------------------------------------------------------
+#if SD_PATH_CACHE_SIZE
+// Location of the directory entry for a path
+struct SdPathEntry
+{
+     uint32_t  hash ;              // hash of the path, zero if unused
+     uint32_t  dirBlock ;          // block holding the directory entry
+     uint8_t   dirIndex ;          // index of the entry in 'dirBlock'
+     uint8_t   length ;            // characters hashed
+     uint16_t  check ;             // second hash of the path
+} ;
+#endif
 
 //-----------------------------------------------------------------------------
 //                                                            F U N C T I O N S
@@ -66,6 +119,10 @@ public:
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Constructors
                File      (SdFile f, const char * name) ;    // wraps an underlying SdFile
                File      (void) ;
+               File      (const File & f) ;                 // shares the same SdFile
+#if __cplusplus >= 201103L
+               File      (File && f) ;                      // takes over the SdFile
+#endif
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - Destructors
               ~File      (void) ;
@@ -78,9 +135,16 @@ public:
      virtual int         available () ;
      virtual void        flush     () ;
 
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Operators
+     File &    operator= (const File & f) ;
+#if __cplusplus >= 201103L
+     File &    operator= (File && f) ;
+#endif
+
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Public Functions
      int       read      (void * buf, uint16_t nbyte) ;
      boolean   seek      (uint32_t pos) ;
+     boolean   writeLog  (const uint8_t * block) ;
      uint32_t  position  () ;
      uint32_t  size      () ;
      void      close     () ;
@@ -93,8 +157,27 @@ public:
 
      using     Print::write ;
 
+// SdFile pool statistics.
+     static uint8_t      poolInUse      (void) ;     // slots in use now
+     static uint8_t      poolPeak       (void) ;     // most slots ever in use
+     static uint16_t     poolFailures   (void) ;     // opens refused, pool full
+
+#if SD_WRITE_BEHIND
+// Buffered appends to a contiguous file, such as one made by SD.createLog().
+// Call poll() often; flush(), close() or any read or seek writes the buffers.
+     boolean   beginWriteBehind    (void) ;
+     void      endWriteBehind      (void) ;
+     void      poll                (void) ;
+
+// Microseconds spent in write(), the part of it spent waiting for the card,
+// and the time the card was seen busy programming blocks.
+     static void         writeBehindStats    (uint32_t * writeMicros, uint32_t * waitMicros, uint32_t * busyMicros) ;
+     static void         writeBehindStatsClear (void) ;
+#endif
+
 private:
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - Private Functions
+     void      release   (void) ;
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Private Data
      char      _name [13] ;
@@ -110,12 +193,21 @@ public:
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Public Functions
 // This needs to be called to set up the connection to the SD card before other methods are used.
      boolean   begin     (uint8_t csPin = SD_CHIP_SELECT_PIN) ;
+
+// Use a block device other than the SPI card, for example an SdImageCard
+// holding a disk image when the library is built on a Linux host.
+     boolean   begin     (SdBlockDevice & device) ;
   
 // Open the specified file/directory with the supplied mode (e.g. read or
 // write, etc). Returns a File object for interacting with the file.
 // Note that currently only one file can be open at a time.
      File      open      (const char * filename, uint8_t mode = FILE_READ) ;
 
+// Create a log file with 'size' bytes of contiguous space reserved on the
+// card. Data is appended 512 bytes at a time with File::writeLog() and the
+// file size is saved by flush() or close().
+     File      createLog (const char * filename, uint32_t size) ;
+
 // Methods to determine if the requested file path exists.
      boolean   exists    (char * filepath) ;
 
@@ -124,9 +216,20 @@ public:
      boolean   remove    (char * filepath) ;
      boolean   rmdir     (char * filepath) ;
 
+#if SD_PATH_CACHE_SIZE
+// Path lookup cache statistics and reset.
+     uint32_t  pathCacheHits       (void) { return pathHits ; }
+     uint32_t  pathCacheMisses     (void) { return pathMisses ; }
+     void      pathCacheClear      (void) ;
+#endif
+
 private:
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - Private Functions
      SdFile    getParentDir   (const char * filepath, int * indx) ;
+#if SD_PATH_CACHE_SIZE
+     boolean   pathCacheOpen  (SdFile & file, const char * filepath, int length, uint8_t mode) ;
+     void      pathCacheAdd   (const char * filepath, int length, SdFile & file) ;
+#endif
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Private Data
 // These are required for initialisation and use of sdfatlib
@@ -141,9 +244,18 @@ private:
 // It shouldn't be set directly--it is set via the parameters to `open`.
      int       fileOpenMode ;
 
+#if SD_PATH_CACHE_SIZE
+// Recently used paths, replaced in turn
+     SdPathEntry    pathCache [SD_PATH_CACHE_SIZE] ;
+     uint8_t        pathNext ;
+     uint32_t       pathHits ;
+     uint32_t       pathMisses ;
+#endif
+
      friend class File ;
 
      friend boolean callback_openPath (SdFile &, char *, boolean, void *) ;
+     friend boolean callback_pathExists (SdFile &, char *, boolean, void *) ;
 } ;
 
 extern SDClass SD ;
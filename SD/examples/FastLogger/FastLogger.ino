@@ -0,0 +1,127 @@
+/*
+  SD card fast logger
+
+ This example reserves contiguous space for a log file with SD.createLog()
+ and appends 512 byte blocks with File::writeLog(). The time taken by
+ each append is measured and a histogram, the 99th percentile and the
+ maximum are printed so the worst case latency can be compared with
+ File::write() on the same card.
+
+ The circuit:
+ * SD card attached to SPI bus as follows:
+ ** MOSI - pin 11
+ ** MISO - pin 12
+ ** CLK - pin 13
+ ** CS - pin 4
+
+ This example code is in the public domain.
+
+ */
+
+#include <SD.h>
+
+// number of blocks appended by each test
+#define BLOCK_COUNT 2000
+
+// histogram bucket width in microseconds and number of buckets
+#define BUCKET_US 250
+#define BUCKET_COUNT 16
+
+uint8_t block[512];
+uint16_t histogram[BUCKET_COUNT];
+uint32_t maxMicros;
+
+void clearStats()
+{
+  for (uint8_t i = 0; i < BUCKET_COUNT; i++) histogram[i] = 0;
+  maxMicros = 0;
+}
+
+void addSample(uint32_t us)
+{
+  uint32_t i = us / BUCKET_US;
+  if (i >= BUCKET_COUNT) i = BUCKET_COUNT - 1;
+  histogram[i]++;
+  if (us > maxMicros) maxMicros = us;
+}
+
+void printStats(const char *title)
+{
+  Serial.println(title);
+  // percentile is the upper edge of the bucket that holds it
+  uint32_t total = 0;
+  uint8_t p99 = BUCKET_COUNT - 1;
+  for (uint8_t i = 0; i < BUCKET_COUNT; i++) {
+    total += histogram[i];
+    if (total * 100 >= 99UL * BLOCK_COUNT && p99 == BUCKET_COUNT - 1) p99 = i;
+    Serial.print("  < ");
+    Serial.print((i + 1) * BUCKET_US);
+    Serial.print(" us: ");
+    Serial.println(histogram[i]);
+  }
+  Serial.print("  p99 < ");
+  Serial.print((p99 + 1) * BUCKET_US);
+  Serial.print(" us, max ");
+  Serial.print(maxMicros);
+  Serial.println(" us");
+}
+
+void setup()
+{
+  // Open serial communications and wait for port to open:
+  Serial.begin(9600);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for Leonardo only
+  }
+
+  // the hardware SS pin must be left as an output
+  pinMode(10, OUTPUT);
+
+  if (!SD.begin(4)) {
+    Serial.println("initialization failed!");
+    return;
+  }
+  SD.remove("WRITE.BIN");
+  SD.remove("LOG.BIN");
+
+  for (uint16_t i = 0; i < 512; i++) block[i] = i;
+
+  // normal append, the FAT is updated at each cluster boundary
+  File file = SD.open("WRITE.BIN", FILE_WRITE);
+  if (!file) {
+    Serial.println("open failed!");
+    return;
+  }
+  clearStats();
+  for (uint16_t n = 0; n < BLOCK_COUNT; n++) {
+    uint32_t t = micros();
+    file.write(block, 512);
+    addSample(micros() - t);
+  }
+  file.close();
+  printStats("File::write()");
+
+  // append to space reserved by createLog()
+  file = SD.createLog("LOG.BIN", 512UL * BLOCK_COUNT);
+  if (!file) {
+    Serial.println("createLog failed!");
+    return;
+  }
+  clearStats();
+  for (uint16_t n = 0; n < BLOCK_COUNT; n++) {
+    uint32_t t = micros();
+    if (!file.writeLog(block)) {
+      Serial.println("writeLog failed!");
+      break;
+    }
+    addSample(micros() - t);
+  }
+  // save the file size
+  file.close();
+  printStats("File::writeLog()");
+}
+
+void loop()
+{
+  // nothing happens after setup
+}
@@ -90,6 +90,9 @@ void spiSend(uint8_t data) {
 //------------------------------------------------------------------------------
 // send command and return error code.  Return zero for OK
 uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
+  // the card would take the command as data for an open multiple block write
+  if (inWrite_) writeStop();
+
   // end read if in partialBlockRead mode
   readEnd();
 
@@ -111,6 +114,9 @@ uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
   if (cmd == CMD8) crc = 0X87;  // correct crc for CMD8 with arg 0X1AA
   spiSend(crc);
 
+  // skip stuff byte for stop read
+  if (cmd == CMD12) spiRec();
+
   // wait for response
   for (uint8_t i = 0; ((status_ = spiRec()) & 0X80) && i != 0XFF; i++);
   return status_;
@@ -211,7 +217,7 @@ uint8_t Sd2Card::eraseSingleBlockEnable(void) {
  * can be determined by calling errorCode() and errorData().
  */
 uint8_t Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
-  errorCode_ = inBlock_ = partialBlockRead_ = type_ = 0;
+  errorCode_ = inBlock_ = inWrite_ = partialBlockRead_ = type_ = 0;
   chipSelectPin_ = chipSelectPin;
   // 16-bit init start time allows over a minute
   uint16_t t0 = (uint16_t)millis();
@@ -291,6 +297,22 @@ uint8_t Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
   return false;
 }
 //------------------------------------------------------------------------------
+/**
+ * Check if the card is busy programming a block.
+ *
+ * Use between writeStart() and writeStop() to find when writeData() can
+ * send the next block without waiting.
+ *
+ * \return The value one, true, is returned if the card is busy and
+ * the value zero, false, is returned if the card is ready.
+ */
+uint8_t Sd2Card::isBusy(void) {
+  chipSelectLow();
+  uint8_t rtn = spiRec() != 0XFF;
+  chipSelectHigh();
+  return rtn;
+}
+//------------------------------------------------------------------------------
 /**
  * Enable or disable partial block reads.
  *
@@ -398,6 +420,44 @@ uint8_t Sd2Card::readData(uint32_t block,
   return false;
 }
 //------------------------------------------------------------------------------
+/** Read one data block in a multiple block read sequence
+ *
+ * \param[out] dst Pointer to the location for the 512 byte data block.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::readData(uint8_t* dst) {
+  // wait for start of next block
+  if (!waitStartBlock()) return false;
+
+#ifdef OPTIMIZE_HARDWARE_SPI
+  // start first spi transfer
+  SPDR = 0XFF;
+
+  // transfer data
+  for (uint16_t i = 0; i < 511; i++) {
+    while (!(SPSR & (1 << SPIF)));
+    dst[i] = SPDR;
+    SPDR = 0XFF;
+  }
+  // wait for last byte
+  while (!(SPSR & (1 << SPIF)));
+  dst[511] = SPDR;
+
+#else  // OPTIMIZE_HARDWARE_SPI
+
+  // transfer data
+  for (uint16_t i = 0; i < 512; i++) {
+    dst[i] = spiRec();
+  }
+#endif  // OPTIMIZE_HARDWARE_SPI
+
+  spiRec();  // get first crc byte
+  spiRec();  // get second crc byte
+  return true;
+}
+//------------------------------------------------------------------------------
 /** Skip remaining data in a block when in partial block read mode. */
 void Sd2Card::readEnd(void) {
   if (inBlock_) {
@@ -439,6 +499,49 @@ uint8_t Sd2Card::readRegister(uint8_t cmd, void* buf) {
   return false;
 }
 //------------------------------------------------------------------------------
+/** Start a read multiple blocks sequence.
+ *
+ * \param[in] blockNumber Address of first block in sequence.
+ *
+ * \note This function is used with readData() and readStop()
+ * for optimized multiple block reads.  The card is selected until
+ * readStop() is called.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::readStart(uint32_t blockNumber) {
+  // use address if not SDHC card
+  if (type() != SD_CARD_TYPE_SDHC) blockNumber <<= 9;
+  if (cardCommand(CMD18, blockNumber)) {
+    error(SD_CARD_ERROR_CMD18);
+    goto fail;
+  }
+  return true;
+
+ fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** End a read multiple blocks sequence.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::readStop(void) {
+  if (cardCommand(CMD12, 0)) {
+    error(SD_CARD_ERROR_CMD12);
+    goto fail;
+  }
+  chipSelectHigh();
+  return true;
+
+ fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
 /**
  * Set the SPI clock rate.
  *
@@ -541,15 +644,26 @@ uint8_t Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src) {
   return false;
 }
 //------------------------------------------------------------------------------
-/** Write one data block in a multiple block write sequence */
+/**
+ * Write one data block in a multiple block write sequence.  The card is
+ * deselected after the block so other devices may use the SPI bus.
+ */
 uint8_t Sd2Card::writeData(const uint8_t* src) {
+  if (!inWrite_) {
+    error(SD_CARD_ERROR_WRITE_MULTIPLE);
+    return false;
+  }
+  chipSelectLow();
   // wait for previous write to finish
   if (!waitNotBusy(SD_WRITE_TIMEOUT)) {
     error(SD_CARD_ERROR_WRITE_MULTIPLE);
     chipSelectHigh();
     return false;
   }
-  return writeData(WRITE_MULTIPLE_TOKEN, src);
+  if (!writeData(WRITE_MULTIPLE_TOKEN, src)) return false;
+  writeBlock_++;
+  chipSelectHigh();
+  return true;
 }
 //------------------------------------------------------------------------------
 // send one block of data for write block or write multiple blocks
@@ -594,7 +708,8 @@ uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
  * \param[in] eraseCount The number of blocks to be pre-erased.
  *
  * \note This function is used with writeData() and writeStop()
- * for optimized multiple block writes.
+ * for optimized multiple block writes.  The card is deselected between
+ * blocks and any other command sends the stop token first.
  *
  * \return The value one, true, is returned for success and
  * the value zero, false, is returned for failure.
@@ -612,12 +727,15 @@ uint8_t Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
     error(SD_CARD_ERROR_ACMD23);
     goto fail;
   }
+  writeBlock_ = blockNumber;
   // use address if not SDHC card
   if (type() != SD_CARD_TYPE_SDHC) blockNumber <<= 9;
   if (cardCommand(CMD25, blockNumber)) {
     error(SD_CARD_ERROR_CMD25);
     goto fail;
   }
+  inWrite_ = 1;
+  chipSelectHigh();
   return true;
 
  fail:
@@ -625,12 +743,15 @@ uint8_t Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
   return false;
 }
 //------------------------------------------------------------------------------
-/** End a write multiple blocks sequence.
+/** End a write multiple blocks sequence.  Does nothing if none is open.
  *
 * \return The value one, true, is returned for success and
  * the value zero, false, is returned for failure.
  */
 uint8_t Sd2Card::writeStop(void) {
+  if (!inWrite_) return true;
+  inWrite_ = 0;
+  chipSelectLow();
   if (!waitNotBusy(SD_WRITE_TIMEOUT)) goto fail;
   spiSend(STOP_TRAN_TOKEN);
   if (!waitNotBusy(SD_WRITE_TIMEOUT)) goto fail;
@@ -24,6 +24,7 @@
  * Sd2Card class
  */
 #include "Sd2PinMap.h"
+#include "SdBlockDevice.h"
 #include "SdInfo.h"
 
 /** Set SCK to max rate of F_CPU/2. See Sd2Card::setSckRate(). */
@@ -138,6 +139,10 @@ uint8_t const SD_CARD_ERROR_WRITE_PROGRAMMING = 0X14;
 uint8_t const SD_CARD_ERROR_WRITE_TIMEOUT = 0X15;
 /** incorrect rate selected */
 uint8_t const SD_CARD_ERROR_SCK_RATE = 0X16;
+/** card returned an error response for CMD12 (stop multiple block read) */
+uint8_t const SD_CARD_ERROR_CMD12 = 0X17;
+/** card returned an error response for CMD18 (read multiple blocks) */
+uint8_t const SD_CARD_ERROR_CMD18 = 0X18;
 //------------------------------------------------------------------------------
 // card types
 /** Standard capacity V1 SD card */
@@ -150,11 +155,14 @@ uint8_t const SD_CARD_TYPE_SDHC = 3;
 /**
  * \class Sd2Card
  * \brief Raw access to SD and SDHC flash memory cards.
+ *
+ * Implements SdBlockDevice for a card on the SPI bus.
  */
-class Sd2Card {
+class Sd2Card : public SdBlockDevice {
  public:
   /** Construct an instance of Sd2Card. */
-  Sd2Card(void) : errorCode_(0), inBlock_(0), partialBlockRead_(0), type_(0) {}
+  Sd2Card(void) : errorCode_(0), inBlock_(0), inWrite_(0),
+    partialBlockRead_(0), type_(0) {}
   uint32_t cardSize(void);
   uint8_t erase(uint32_t firstBlock, uint32_t lastBlock);
   uint8_t eraseSingleBlockEnable(void);
@@ -180,12 +188,21 @@ class Sd2Card {
     return init(sckRateID, SD_CHIP_SELECT_PIN);
   }
   uint8_t init(uint8_t sckRateID, uint8_t chipSelectPin);
+  uint8_t isBusy(void);
+  /**
+   * \return true if a multiple block write is open and \a blockNumber
+   * is the next block it will write.
+   */
+  uint8_t isWriting(uint32_t blockNumber) {
+    return inWrite_ && blockNumber == writeBlock_;
+  }
   void partialBlockRead(uint8_t value);
   /** Returns the current value, true or false, for partial block read. */
   uint8_t partialBlockRead(void) const {return partialBlockRead_;}
   uint8_t readBlock(uint32_t block, uint8_t* dst);
   uint8_t readData(uint32_t block,
           uint16_t offset, uint16_t count, uint8_t* dst);
+  uint8_t readData(uint8_t* dst);
   /**
    * Read a cards CID register. The CID contains card identification
    * information such as Manufacturer ID, Product name, Product serial
@@ -200,6 +217,8 @@ class Sd2Card {
     return readRegister(CMD9, csd);
   }
   void readEnd(void);
+  uint8_t readStart(uint32_t blockNumber);
+  uint8_t readStop(void);
   uint8_t setSckRate(uint8_t sckRateID);
   /** Return the card type: SD V1, SD V2 or SDHC */
   uint8_t type(void) const {return type_;}
@@ -212,10 +231,12 @@ class Sd2Card {
   uint8_t chipSelectPin_;
   uint8_t errorCode_;
   uint8_t inBlock_;
+  uint8_t inWrite_;
   uint16_t offset_;
   uint8_t partialBlockRead_;
   uint8_t status_;
   uint8_t type_;
+  uint32_t writeBlock_;
   // private functions
   uint8_t cardAcmd(uint8_t cmd, uint32_t arg) {
     cardCommand(CMD55, 0);
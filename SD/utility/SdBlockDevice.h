@@ -0,0 +1,70 @@
+/* Arduino SdFat Library
+ * Copyright (C) 2009 by William Greiman
+ *
+ * This file is part of the Arduino SdFat Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef SdBlockDevice_h
+#define SdBlockDevice_h
+/**
+ * \file
+ * SdBlockDevice class
+ */
+#include <stdint.h>
+//------------------------------------------------------------------------------
+/**
+ * \class SdBlockDevice
+ * \brief Interface to a device of 512 byte blocks used by SdVolume.
+ *
+ * Sd2Card implements this interface for an SD card on the SPI bus.
+ * SdImageCard implements it for a disk image file on a Linux host.
+ *
+ * Functions return the value one, true, for success and the value zero,
+ * false, for failure.  The multiple block calls follow the SD protocol:
+ * readStart(), readData() for each block, readStop() and writeStart(),
+ * writeData() for each block, writeStop().  Any other call ends an open
+ * multiple block write.
+ */
+class SdBlockDevice {
+ public:
+  virtual ~SdBlockDevice(void) {}
+  /** \return The number of 512 byte blocks on the device. */
+  virtual uint32_t cardSize(void) = 0;
+  /** \return True if the last block sent by writeData() is not programmed. */
+  virtual uint8_t isBusy(void) = 0;
+  /** \return True if a multiple block write will write blockNumber next. */
+  virtual uint8_t isWriting(uint32_t blockNumber) = 0;
+  /** Read a 512 byte block.  CMD17 on an SD card. */
+  virtual uint8_t readBlock(uint32_t block, uint8_t* dst) = 0;
+  /** Read part of a 512 byte block. */
+  virtual uint8_t readData(uint32_t block,
+          uint16_t offset, uint16_t count, uint8_t* dst) = 0;
+  /** Read the next block of a multiple block read. */
+  virtual uint8_t readData(uint8_t* dst) = 0;
+  /** Start a multiple block read.  CMD18 on an SD card. */
+  virtual uint8_t readStart(uint32_t blockNumber) = 0;
+  /** End a multiple block read.  CMD12 on an SD card. */
+  virtual uint8_t readStop(void) = 0;
+  /** Write a 512 byte block.  CMD24 on an SD card. */
+  virtual uint8_t writeBlock(uint32_t blockNumber, const uint8_t* src) = 0;
+  /** Write the next block of a multiple block write. */
+  virtual uint8_t writeData(const uint8_t* src) = 0;
+  /** Start a multiple block write.  ACMD23 and CMD25 on an SD card. */
+  virtual uint8_t writeStart(uint32_t blockNumber, uint32_t eraseCount) = 0;
+  /** End a multiple block write. */
+  virtual uint8_t writeStop(void) = 0;
+};
+#endif  // SdBlockDevice_h
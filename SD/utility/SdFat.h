@@ -33,6 +33,87 @@
  */
 #define ALLOW_DEPRECATED_FUNCTIONS 1
 //------------------------------------------------------------------------------
+/**
+ * Number of 512 byte blocks held by the SdVolume block cache, 1 - 8.
+ *
+ * With more than one block FAT, directory and file data blocks can stay
+ * cached together so a file append does not force the FAT block out of
+ * the cache.  Boards with more than 2 KB of RAM default to four blocks.
+ */
+#ifndef SD_CACHE_BLOCK_COUNT
+#if defined(RAMEND) && RAMEND > 0X8FF
+#define SD_CACHE_BLOCK_COUNT 4
+#else  // RAMEND
+#define SD_CACHE_BLOCK_COUNT 1
+#endif  // RAMEND
+#endif  // SD_CACHE_BLOCK_COUNT
+
+#if SD_CACHE_BLOCK_COUNT < 1 || SD_CACHE_BLOCK_COUNT > 8
+#error SD_CACHE_BLOCK_COUNT must be in the range 1 - 8
+#endif  // SD_CACHE_BLOCK_COUNT
+//------------------------------------------------------------------------------
+/**
+ * Use multiple block read (CMD18) and write (CMD25) commands if non-zero.
+ *
+ * SdFile::read() and SdFile::write() transfer runs of two or more full
+ * blocks that are physically consecutive on the card with a single
+ * command instead of one command and busy wait per block.
+ */
+#ifndef SD_MULTIPLE_BLOCK_IO
+#define SD_MULTIPLE_BLOCK_IO 1
+#endif  // SD_MULTIPLE_BLOCK_IO
+//------------------------------------------------------------------------------
+/**
+ * Size in bytes of the SdVolume free cluster summary, zero to disable.
+ *
+ * Each bit covers a group of one or more FAT blocks and is set when a
+ * cluster allocation scan finds the group full.  Later scans skip full
+ * groups without reading their FAT blocks.  Freeing a cluster clears the
+ * bit for its group.
+ */
+#ifndef SD_FREE_MAP_BYTES
+#if defined(RAMEND) && RAMEND > 0X8FF
+#define SD_FREE_MAP_BYTES 32
+#else  // RAMEND
+#define SD_FREE_MAP_BYTES 8
+#endif  // RAMEND
+#endif  // SD_FREE_MAP_BYTES
+//------------------------------------------------------------------------------
+/**
+ * Number of cluster runs in each SdFile extent table, zero to disable.
+ *
+ * The table records the file's cluster chain as runs of contiguous
+ * clusters while the chain is followed so SdFile::seekSet() can map a
+ * position to a cluster with a binary search instead of a FAT walk.
+ * Clusters past the last run that fits are found by walking the FAT from
+ * the end of the table.  Each run uses eight bytes in every SdFile.
+ */
+#ifndef SD_EXTENT_COUNT
+#if defined(RAMEND) && RAMEND > 0X8FF
+#define SD_EXTENT_COUNT 4
+#else  // RAMEND
+#define SD_EXTENT_COUNT 0
+#endif  // RAMEND
+#endif  // SD_EXTENT_COUNT
+//------------------------------------------------------------------------------
+/**
+ * Number of names in the directory index, zero to disable the index.
+ *
+ * SdFile::open() by name indexes the directory it searches most often
+ * with a sorted table of name hashes and entry numbers, so an existing
+ * file is found with a binary search instead of a scan of the directory.
+ * Every name is in the index, so a missing name fails and O_CREAT makes
+ * the entry without a scan.  The index also holds the deleted entries
+ * seen when it was built and the first free entry; new names use these.
+ * Entries deleted later are reused after the index is rebuilt, which
+ * happens when the table fills.  Index entries are checked against the
+ * directory entry.  Directories with more names than the index holds are
+ * not indexed.  Each name or deleted entry uses four bytes.
+ */
+#ifndef SD_DIR_INDEX_SIZE
+#define SD_DIR_INDEX_SIZE 0
+#endif  // SD_DIR_INDEX_SIZE
+//------------------------------------------------------------------------------
 // forward declaration since SdVolume is used in SdFile
 class SdVolume;
 //==============================================================================
@@ -153,6 +234,7 @@ class SdFile : public Print {
   uint8_t contiguousRange(uint32_t* bgnBlock, uint32_t* endBlock);
   uint8_t createContiguous(SdFile* dirFile,
           const char* fileName, uint32_t size);
+  uint8_t createLog(SdFile* dirFile, const char* fileName, uint32_t size);
   /** \return The current cluster number for a file or directory. */
   uint32_t curCluster(void) const {return curCluster_;}
   /** \return The current position for a file or directory. */
@@ -222,6 +304,8 @@ class SdFile : public Print {
   uint8_t makeDir(SdFile* dir, const char* dirName);
   uint8_t open(SdFile* dirFile, uint16_t index, uint8_t oflag);
   uint8_t open(SdFile* dirFile, const char* fileName, uint8_t oflag);
+  uint8_t openEntry(SdVolume* vol, uint32_t block, uint8_t index,
+          const char* fileName, uint8_t oflag);
 
   uint8_t openRoot(SdVolume* vol);
   static void printDirName(const dir_t& dir, uint8_t width);
@@ -288,6 +372,8 @@ class SdFile : public Print {
   size_t write(const char* str);
   void write_P(PGM_P str);
   void writeln_P(PGM_P str);
+  uint8_t writeLog(const void* buf);
+  uint8_t writeLogStop(void);
 //------------------------------------------------------------------------------
 #if ALLOW_DEPRECATED_FUNCTIONS
 // Deprecated functions  - suppress cpplint warnings with NOLINT comment
@@ -365,18 +451,24 @@ class SdFile : public Print {
   }
 #endif  // ALLOW_DEPRECATED_FUNCTIONS
  private:
+  // Allow SdVolume::init() to drop the directory index.
+  friend class SdVolume;
+
   // bits defined in flags_
   // should be 0XF
   static uint8_t const F_OFLAG = (O_ACCMODE | O_APPEND | O_SYNC);
   // available bits
-  static uint8_t const F_UNUSED = 0X30;
+  static uint8_t const F_UNUSED = 0X20;
+  // multiple block write to log space is in progress
+  static uint8_t const F_FILE_LOG_STREAM = 0X10;
   // use unbuffered SD read
   static uint8_t const F_FILE_UNBUFFERED_READ = 0X40;
   // sync of directory entry required
   static uint8_t const F_FILE_DIR_DIRTY = 0X80;
 
 // make sure F_OFLAG is ok
-#if ((F_UNUSED | F_FILE_UNBUFFERED_READ | F_FILE_DIR_DIRTY) & F_OFLAG)
+#if ((F_UNUSED | F_FILE_LOG_STREAM | F_FILE_UNBUFFERED_READ\
+  | F_FILE_DIR_DIRTY) & F_OFLAG)
 #error flags_ bits conflict
 #endif  // flags_ bits
 
@@ -390,15 +482,47 @@ class SdFile : public Print {
   uint32_t  fileSize_;      // file size in bytes
   uint32_t  firstCluster_;  // first cluster of file
   SdVolume* vol_;           // volume where file is located
+  uint32_t  logEndBlock_;   // last block of log space, zero if not known
+#if SD_EXTENT_COUNT
+  uint32_t  extentCluster_[SD_EXTENT_COUNT];  // first cluster of each run
+  uint32_t  extentIndex_[SD_EXTENT_COUNT];    // file cluster index of run
+  uint8_t   extentCount_;   // number of runs in the extent table
+  uint32_t  extentEnd_;     // clusters mapped by the extent table
+#endif  // SD_EXTENT_COUNT
 
   // private functions
   uint8_t addCluster(void);
   uint8_t addDirCluster(void);
   dir_t* cacheDirEntry(uint8_t action);
   static void (*dateTime_)(uint16_t* date, uint16_t* time);
+#if SD_DIR_INDEX_SIZE
+  // values for dirIndexState_
+  static uint8_t const DIR_INDEX_SEEN = 1;   // searched once, build next time
+  static uint8_t const DIR_INDEX_VALID = 2;  // table holds the directory
+  static uint8_t const DIR_INDEX_FULL = 3;   // too many names to index
+  // hash for a deleted entry, sorts after all names
+  static uint16_t const DIR_INDEX_DELETED = 0XFFFF;
+  static SdVolume* dirIndexVol_;      // volume of indexed directory
+  static uint32_t dirIndexCluster_;   // first cluster of indexed directory
+  static uint8_t dirIndexState_;      // see above
+  static uint16_t dirIndexCount_;     // names in dirIndexTable_
+  static uint16_t dirIndexEnd_;       // first free entry
+  static uint32_t dirIndexTable_[SD_DIR_INDEX_SIZE];  // hash<<16 | entry
+  static void dirIndexAdd(uint16_t hash, uint16_t entry);
+  uint8_t dirIndexBuild(void);
+  static uint16_t dirIndexFind(uint16_t hash);
+  static uint16_t dirIndexHash(const uint8_t* dname);
+#endif  // SD_DIR_INDEX_SIZE
+#if SD_EXTENT_COUNT
+  void extentClear(void) {extentCount_ = 0; extentEnd_ = 0;}
+  uint32_t extentCluster(uint32_t index) const;
+  void extentNote(uint32_t index, uint32_t cluster);
+#endif  // SD_EXTENT_COUNT
   static uint8_t make83Name(const char* str, uint8_t* name);
   uint8_t openCachedEntry(uint8_t cacheIndex, uint8_t oflags);
   dir_t* readDirCache(void);
+  int16_t readMultiple(uint32_t block, uint8_t* dst, uint16_t maxCount);
+  int16_t writeMultiple(uint32_t block, const uint8_t* src, uint16_t maxCount);
 };
 //==============================================================================
 // SdVolume class
@@ -433,22 +557,34 @@ class SdVolume {
    */
   static uint8_t* cacheClear(void) {
     cacheFlush();
-    cacheBlockNumber_ = 0XFFFFFFFF;
-    return cacheBuffer_.data;
+    for (uint8_t i = 0; i < SD_CACHE_BLOCK_COUNT; i++) cacheState_[i] = 0;
+    cacheUse(0);
+    return cacheBuffer_->data;
+  }
+  /** \return Number of block requests satisfied from the cache. */
+  static uint32_t cacheHitCount(void) {return cacheHitCount_;}
+  /** \return Number of block requests that required a device read. */
+  static uint32_t cacheMissCount(void) {return cacheMissCount_;}
+  /** \return Number of dirty cache blocks written back to the device. */
+  static uint32_t cacheFlushCount(void) {return cacheFlushCount_;}
+  /** Set the cache hit, miss and flush counters to zero. */
+  static void cacheStatsClear(void) {
+    cacheHitCount_ = cacheMissCount_ = cacheFlushCount_ = 0;
   }
   /**
    * Initialize a FAT volume.  Try partition one first then try super
    * floppy format.
    *
-   * \param[in] dev The Sd2Card where the volume is located.
+   * \param[in] dev The SD card or other block device where the volume
+   * is located.
    *
    * \return The value one, true, is returned for success and
    * the value zero, false, is returned for failure.  Reasons for
    * failure include not finding a valid partition, not finding a valid
    * FAT file system or an I/O error.
    */
-  uint8_t init(Sd2Card* dev) { return init(dev, 1) ? true : init(dev, 0);}
-  uint8_t init(Sd2Card* dev, uint8_t part);
+  uint8_t init(SdBlockDevice* dev) { return init(dev, 1) ? true : init(dev, 0);}
+  uint8_t init(SdBlockDevice* dev, uint8_t part);
 
   // inline functions that return volume info
   /** \return The volume's cluster size in blocks. */
@@ -472,16 +608,20 @@ class SdVolume {
   /** \return The logical block number for the start of the root directory
        on FAT16 volumes or the first cluster number on FAT32 volumes. */
   uint32_t rootDirStart(void) const {return rootDirStart_;}
-  /** return a pointer to the Sd2Card object for this volume */
-  static Sd2Card* sdCard(void) {return sdCard_;}
+  /** return a pointer to the block device for this volume */
+  static SdBlockDevice* blockDevice(void) {return sdCard_;}
+  /** return a pointer to the SD card for this volume.  Only valid if the
+   *  volume was initialized with an Sd2Card, use blockDevice() otherwise */
+  static Sd2Card* sdCard(void) {return static_cast<Sd2Card*>(sdCard_);}
 //------------------------------------------------------------------------------
 #if ALLOW_DEPRECATED_FUNCTIONS
   // Deprecated functions  - suppress cpplint warnings with NOLINT comment
-  /** \deprecated Use: uint8_t SdVolume::init(Sd2Card* dev); */
-  uint8_t init(Sd2Card& dev) {return init(&dev);}  // NOLINT
+  /** \deprecated Use: uint8_t SdVolume::init(SdBlockDevice* dev); */
+  uint8_t init(SdBlockDevice& dev) {return init(&dev);}  // NOLINT
 
-  /** \deprecated Use: uint8_t SdVolume::init(Sd2Card* dev, uint8_t vol); */
-  uint8_t init(Sd2Card& dev, uint8_t part) {  // NOLINT
+  /** \deprecated Use: uint8_t SdVolume::init(SdBlockDevice* dev,
+   *  uint8_t vol); */
+  uint8_t init(SdBlockDevice& dev, uint8_t part) {  // NOLINT
     return init(&dev, part);
   }
 #endif  // ALLOW_DEPRECATED_FUNCTIONS
@@ -494,12 +634,29 @@ class SdVolume {
   static uint8_t const CACHE_FOR_READ = 0;
   // value for action argument in cacheRawBlock to indicate cache dirty
   static uint8_t const CACHE_FOR_WRITE = 1;
+  // or'ed into action to prefer keeping a directory block over file data
+  static uint8_t const CACHE_PIN_DIR = 2;
+  // or'ed into action to prefer keeping a FAT block over directory and data
+  static uint8_t const CACHE_PIN_FAT = 4;
+  // mask for the pin bits, larger values are replaced last
+  static uint8_t const CACHE_PIN_MASK = CACHE_PIN_DIR | CACHE_PIN_FAT;
+  // cacheState_ bit for an entry that holds a valid block
+  static uint8_t const CACHE_STATE_VALID = 0X80;
+  // cacheFind() return value for a block that is not in the cache
+  static uint8_t const CACHE_NONE = 0XFF;
 
-  static cache_t cacheBuffer_;        // 512 byte cache for device blocks
-  static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
-  static Sd2Card* sdCard_;            // Sd2Card object for cache
-  static uint8_t cacheDirty_;         // cacheFlush() will write block if true
-  static uint32_t cacheMirrorBlock_;  // block number for mirror FAT
+  static cache_t cacheBlock_[SD_CACHE_BLOCK_COUNT];    // 512 byte blocks
+  static uint32_t cacheNumber_[SD_CACHE_BLOCK_COUNT];  // block in each entry
+  static uint32_t cacheMirror_[SD_CACHE_BLOCK_COUNT];  // mirror FAT block
+  static uint8_t cacheState_[SD_CACHE_BLOCK_COUNT];    // valid, dirty and pin
+  static uint8_t cacheAge_[SD_CACHE_BLOCK_COUNT];      // zero is most recent
+  static uint8_t cacheCurrent_;       // index of entry last accessed
+  static cache_t* cacheBuffer_;       // buffer for entry last accessed
+  static uint32_t cacheBlockNumber_;  // block for entry last accessed
+  static uint32_t cacheHitCount_;     // requests found in the cache
+  static uint32_t cacheMissCount_;    // requests read from the device
+  static uint32_t cacheFlushCount_;   // dirty blocks written to the device
+  static SdBlockDevice* sdCard_;      // block device for cache
 //
   uint32_t allocSearchStart_;   // start cluster for alloc search
   uint8_t blocksPerCluster_;    // cluster size in blocks
@@ -512,6 +669,10 @@ class SdVolume {
   uint8_t fatType_;             // volume type (12, 16, OR 32)
   uint16_t rootDirEntryCount_;  // number of entries in FAT16 root dir
   uint32_t rootDirStart_;       // root start block for FAT16, cluster for FAT32
+#if SD_FREE_MAP_BYTES
+  uint8_t freeMap_[SD_FREE_MAP_BYTES];  // bit set if cluster group is full
+  uint8_t freeMapShift_;        // shift to convert cluster to group number
+#endif  // SD_FREE_MAP_BYTES
   //----------------------------------------------------------------------------
   uint8_t allocContiguous(uint32_t count, uint32_t* curCluster);
   uint8_t blockOfCluster(uint32_t position) const {
@@ -520,9 +681,17 @@ class SdVolume {
            return dataStartBlock_ + ((cluster - 2) << clusterSizeShift_);}
   uint32_t blockNumber(uint32_t cluster, uint32_t position) const {
            return clusterStartBlock(cluster) + blockOfCluster(position);}
+  static uint8_t cacheFind(uint32_t blockNumber);
   static uint8_t cacheFlush(void);
+  static uint8_t cacheFlushEntry(uint8_t i);
+  static void cacheInvalidate(uint32_t blockNumber);
+  static uint8_t cacheNewBlock(uint32_t blockNumber);
   static uint8_t cacheRawBlock(uint32_t blockNumber, uint8_t action);
-  static void cacheSetDirty(void) {cacheDirty_ |= CACHE_FOR_WRITE;}
+  static void cacheSetDirty(void) {
+    cacheState_[cacheCurrent_] |= CACHE_FOR_WRITE;
+  }
+  static void cacheUse(uint8_t i);
+  static uint8_t cacheVictim(void);
   static uint8_t cacheZeroBlock(uint32_t blockNumber);
   uint8_t chainSize(uint32_t beginCluster, uint32_t* size) const;
   uint8_t fatGet(uint32_t cluster, uint32_t* value) const;
@@ -531,11 +700,26 @@ class SdVolume {
     return fatPut(cluster, 0x0FFFFFFF);
   }
   uint8_t freeChain(uint32_t cluster);
+#if SD_FREE_MAP_BYTES
+  uint8_t freeMapIsFull(uint32_t cluster) const {
+    uint16_t g = cluster >> freeMapShift_;
+    return freeMap_[g >> 3] & (1 << (g & 7));
+  }
+  void freeMapSetFree(uint32_t cluster) {
+    uint16_t g = cluster >> freeMapShift_;
+    freeMap_[g >> 3] &= ~(1 << (g & 7));
+  }
+  void freeMapSetFull(uint32_t cluster) {
+    uint16_t g = cluster >> freeMapShift_;
+    freeMap_[g >> 3] |= 1 << (g & 7);
+  }
+#endif  // SD_FREE_MAP_BYTES
   uint8_t isEOC(uint32_t cluster) const {
     return  cluster >= (fatType_ == 16 ? FAT16EOC_MIN : FAT32EOC_MIN);
   }
   uint8_t readBlock(uint32_t block, uint8_t* dst) {
     return sdCard_->readBlock(block, dst);}
+  uint8_t readBlocks(uint32_t block, uint16_t count, uint8_t* dst);
   uint8_t readData(uint32_t block, uint16_t offset,
     uint16_t count, uint8_t* dst) {
       return sdCard_->readData(block, offset, count, dst);
@@ -543,5 +727,6 @@ class SdVolume {
   uint8_t writeBlock(uint32_t block, const uint8_t* dst) {
     return sdCard_->writeBlock(block, dst);
   }
+  uint8_t writeBlocks(uint32_t block, uint16_t count, const uint8_t* src);
 };
 #endif  // SdFat_h
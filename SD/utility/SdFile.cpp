@@ -34,6 +34,16 @@ void (*SdFile::dateTime_)(uint16_t* date, uint16_t* time) = NULL;
 // suppress cpplint warnings with NOLINT comment
 void (*SdFile::oldDateTime_)(uint16_t& date, uint16_t& time) = NULL;  // NOLINT
 #endif  // ALLOW_DEPRECATED_FUNCTIONS
+
+#if SD_DIR_INDEX_SIZE
+// name index for one directory
+SdVolume* SdFile::dirIndexVol_ = NULL;
+uint32_t SdFile::dirIndexCluster_;
+uint8_t SdFile::dirIndexState_;
+uint16_t SdFile::dirIndexCount_;
+uint16_t SdFile::dirIndexEnd_;
+uint32_t SdFile::dirIndexTable_[SD_DIR_INDEX_SIZE];
+#endif  // SD_DIR_INDEX_SIZE
 //------------------------------------------------------------------------------
 // add a cluster to a file
 uint8_t SdFile::addCluster() {
@@ -59,14 +69,18 @@ uint8_t SdFile::addDirCluster(void) {
   }
   // Increase directory file size by cluster size
   fileSize_ += 512UL << vol_->clusterSizeShift_;
+
+  // curCluster_ no longer matches curPosition_
+  rewind();
   return true;
 }
 //------------------------------------------------------------------------------
 // cache a file's directory entry
 // return pointer to cached entry or null for failure
 dir_t* SdFile::cacheDirEntry(uint8_t action) {
+  action |= SdVolume::CACHE_PIN_DIR;
   if (!SdVolume::cacheRawBlock(dirBlock_, action)) return NULL;
-  return SdVolume::cacheBuffer_.dir + dirIndex_;
+  return SdVolume::cacheBuffer_->dir + dirIndex_;
 }
 //------------------------------------------------------------------------------
 /**
@@ -148,11 +162,52 @@ uint8_t SdFile::createContiguous(SdFile* dirFile,
   }
   fileSize_ = size;
 
+#if SD_EXTENT_COUNT
+  // the file is one run of clusters
+  extentClear();
+  extentNote(0, firstCluster_);
+  extentEnd_ = count;
+#endif  // SD_EXTENT_COUNT
+
   // insure sync() will update dir entry
   flags_ |= F_FILE_DIR_DIRTY;
   return sync();
 }
 //------------------------------------------------------------------------------
+/**
+ * Create and open a new log file with contiguous space reserved for data.
+ *
+ * The file is created by createContiguous() and then set to zero length so
+ * writeLog() can append blocks to the reserved space without FAT updates.
+ *
+ * Until the file is synced its directory entry has a size smaller than its
+ * clusters, and after a power cut a disk check reports the rest as a lost
+ * chain.  Open the file with O_WRITE and call truncate(0), or remove it, to
+ * free them; the blocks written are still on the card until reused.
+ *
+ * \param[in] dirFile The directory where the file will be created.
+ * \param[in] fileName A valid DOS 8.3 file name.
+ * \param[in] size The number of bytes to reserve.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ * Reasons for failure are the same as for createContiguous().
+ */
+uint8_t SdFile::createLog(SdFile* dirFile,
+        const char* fileName, uint32_t size) {
+  uint32_t bgnBlock;
+
+  if (!createContiguous(dirFile, fileName, size)) return false;
+
+  // remember the end of the reserved space for writeLog()
+  if (!contiguousRange(&bgnBlock, &logEndBlock_)) return false;
+
+  // clusters stay allocated beyond the end of file
+  fileSize_ = 0;
+  flags_ |= F_FILE_DIR_DIRTY;
+  return sync();
+}
+//------------------------------------------------------------------------------
 /**
  * Return a files directory entry
  *
@@ -191,6 +246,135 @@ void SdFile::dirName(const dir_t& dir, char* name) {
   name[j] = 0;
 }
 //------------------------------------------------------------------------------
+#if SD_EXTENT_COUNT
+// map a file cluster index below extentEnd_ to a cluster number
+uint32_t SdFile::extentCluster(uint32_t index) const {
+  // binary search for the last run that starts at or before index
+  uint8_t lo = 0;
+  uint8_t hi = extentCount_;
+  while ((hi - lo) > 1) {
+    uint8_t mid = (lo + hi) >> 1;
+    if (extentIndex_[mid] <= index) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return extentCluster_[lo] + (index - extentIndex_[lo]);
+}
+//------------------------------------------------------------------------------
+// record that file cluster index is cluster if it follows the table's end
+void SdFile::extentNote(uint32_t index, uint32_t cluster) {
+  if (index != extentEnd_) return;
+  uint8_t last = extentCount_ - 1;
+  if (extentCount_ &&
+    cluster == (extentCluster_[last] + (index - extentIndex_[last]))) {
+    // extend last run
+    extentEnd_++;
+  } else if (extentCount_ < SD_EXTENT_COUNT) {
+    // start a new run
+    extentCluster_[extentCount_] = cluster;
+    extentIndex_[extentCount_] = index;
+    extentCount_++;
+    extentEnd_++;
+  }
+}
+#endif  // SD_EXTENT_COUNT
+//------------------------------------------------------------------------------
+#if SD_DIR_INDEX_SIZE
+// insert an entry in the directory index
+void SdFile::dirIndexAdd(uint16_t hash, uint16_t entry) {
+  if (dirIndexCount_ >= SD_DIR_INDEX_SIZE) {
+    // rebuild without names that have been removed
+    dirIndexState_ = DIR_INDEX_SEEN;
+    return;
+  }
+  uint32_t v = ((uint32_t)hash << 16) | entry;
+  uint16_t i = dirIndexCount_++;
+  while (i && dirIndexTable_[i - 1] > v) {
+    dirIndexTable_[i] = dirIndexTable_[i - 1];
+    i--;
+  }
+  dirIndexTable_[i] = v;
+}
+//------------------------------------------------------------------------------
+// index all names and deleted entries in this directory
+uint8_t SdFile::dirIndexBuild(void) {
+  dir_t* p;
+  dirIndexCount_ = 0;
+  dirIndexEnd_ = fileSize_ >> 5;
+  dirIndexState_ = DIR_INDEX_VALID;
+  rewind();
+  while (curPosition_ < fileSize_) {
+    uint16_t entry = curPosition_ >> 5;
+    p = readDirCache();
+    if (p == NULL) {
+      dirIndexState_ = DIR_INDEX_SEEN;
+      return false;
+    }
+    // done if past last used entry
+    if (p->name[0] == DIR_NAME_FREE) {
+      dirIndexEnd_ = entry;
+      break;
+    }
+    uint16_t hash;
+    if (p->name[0] == DIR_NAME_DELETED) {
+      // keep deleted entries for new names if there is room
+      if (dirIndexCount_ >= SD_DIR_INDEX_SIZE) continue;
+      hash = DIR_INDEX_DELETED;
+    } else {
+      // skip '.', '..', long names and volume labels
+      if (p->name[0] == '.' || !DIR_IS_FILE_OR_SUBDIR(p)) continue;
+      hash = dirIndexHash(p->name);
+    }
+    // entries are in order so append and sort once at the end
+    if (dirIndexCount_ >= SD_DIR_INDEX_SIZE) {
+      dirIndexState_ = DIR_INDEX_FULL;
+      return true;
+    }
+    dirIndexTable_[dirIndexCount_++] = ((uint32_t)hash << 16) | entry;
+  }
+  // Shell sort, gaps 1, 4, 13, 40, ...
+  uint16_t gap = 1;
+  while (gap < dirIndexCount_ / 3) gap = 3 * gap + 1;
+  for (; gap; gap /= 3) {
+    for (uint16_t i = gap; i < dirIndexCount_; i++) {
+      uint32_t v = dirIndexTable_[i];
+      uint16_t j = i;
+      for (; j >= gap && dirIndexTable_[j - gap] > v; j -= gap) {
+        dirIndexTable_[j] = dirIndexTable_[j - gap];
+      }
+      dirIndexTable_[j] = v;
+    }
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// return position of first index entry with hash or dirIndexCount_
+uint16_t SdFile::dirIndexFind(uint16_t hash) {
+  uint32_t v = (uint32_t)hash << 16;
+  uint16_t lo = 0;
+  uint16_t hi = dirIndexCount_;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) >> 1;
+    if (dirIndexTable_[mid] < v) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+//------------------------------------------------------------------------------
+// 16-bit FNV-1a hash of an 11 byte directory name, never DIR_INDEX_DELETED
+uint16_t SdFile::dirIndexHash(const uint8_t* dname) {
+  uint32_t h = 2166136261UL;
+  for (uint8_t i = 0; i < 11; i++) h = (h ^ dname[i]) * 16777619UL;
+  uint16_t hash = h ^ (h >> 16);
+  return hash == DIR_INDEX_DELETED ? hash - 1 : hash;
+}
+#endif  // SD_DIR_INDEX_SIZE
+//------------------------------------------------------------------------------
 /** List directory contents to Serial.
  *
  * \param[in] flags The inclusive OR of
@@ -317,10 +501,11 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
 
   // cache block for '.'  and '..'
   uint32_t block = vol_->clusterStartBlock(firstCluster_);
-  if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) return false;
+  uint8_t action = SdVolume::CACHE_FOR_WRITE | SdVolume::CACHE_PIN_DIR;
+  if (!SdVolume::cacheRawBlock(block, action)) return false;
 
   // copy '.' to block
-  memcpy(&SdVolume::cacheBuffer_.dir[0], &d, sizeof(d));
+  memcpy(&SdVolume::cacheBuffer_->dir[0], &d, sizeof(d));
 
   // make entry for '..'
   d.name[1] = '.';
@@ -332,7 +517,7 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
     d.firstClusterHigh = dir->firstCluster_ >> 16;
   }
   // copy '..' to block
-  memcpy(&SdVolume::cacheBuffer_.dir[1], &d, sizeof(d));
+  memcpy(&SdVolume::cacheBuffer_->dir[1], &d, sizeof(d));
 
   // set position after '..'
   curPosition_ = 2 * sizeof(d);
@@ -396,11 +581,72 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
 
   if (!make83Name(fileName, dname)) return false;
   vol_ = dirFile->vol_;
-  dirFile->rewind();
 
   // bool for empty entry found
   uint8_t emptyFound = false;
 
+#if SD_DIR_INDEX_SIZE
+  // entry number of empty slot
+  uint16_t emptyEntry = 0;
+  uint16_t hash = dirIndexHash(dname);
+  uint8_t indexed = dirIndexVol_ == vol_
+                    && dirIndexCluster_ == dirFile->firstCluster_;
+  if (!indexed) {
+    // build index if this directory is searched again
+    dirIndexVol_ = vol_;
+    dirIndexCluster_ = dirFile->firstCluster_;
+    dirIndexState_ = DIR_INDEX_SEEN;
+  } else if (dirIndexState_ == DIR_INDEX_SEEN) {
+    if (!dirFile->dirIndexBuild()) return false;
+  }
+  if (indexed && dirIndexState_ == DIR_INDEX_VALID) {
+    // check each entry with a matching hash
+    for (uint16_t i = dirIndexFind(hash);
+         i < dirIndexCount_ && (dirIndexTable_[i] >> 16) == hash; i++) {
+      if (!dirFile->seekSet(32UL * (dirIndexTable_[i] & 0XFFFF))) return false;
+      uint8_t index = 0XF & (dirFile->curPosition_ >> 5);
+      p = dirFile->readDirCache();
+      if (p == NULL) return false;
+      if (!memcmp(dname, p->name, 11)) {
+        // don't open existing file if O_CREAT and O_EXCL
+        if ((oflag & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL)) return false;
+        return openCachedEntry(index, oflag);
+      }
+    }
+    // every name is in the index so the file does not exist
+    if ((oflag & (O_CREAT | O_WRITE)) != (O_CREAT | O_WRITE)) return false;
+
+    // use a deleted entry from the index or the first free entry
+    for (;;) {
+      if (dirIndexCount_
+        && (dirIndexTable_[dirIndexCount_ - 1] >> 16) == DIR_INDEX_DELETED) {
+        emptyEntry = dirIndexTable_[--dirIndexCount_];
+      } else if (dirIndexEnd_ < (dirFile->fileSize_ >> 5)) {
+        emptyEntry = dirIndexEnd_;
+      } else {
+        // directory is full, addDirCluster() links to the last cluster
+        if (!dirFile->seekSet(dirFile->fileSize_)) return false;
+        goto create;
+      }
+      if (!dirFile->seekSet(32UL * emptyEntry)) return false;
+      p = dirFile->readDirCache();
+      if (p == NULL) return false;
+      if (p->name[0] == DIR_NAME_FREE || p->name[0] == DIR_NAME_DELETED) {
+        emptyFound = true;
+        dirIndex_ = 0XF & emptyEntry;
+        dirBlock_ = SdVolume::cacheBlockNumber_;
+        goto create;
+      }
+      // the directory changed without the index, search it instead
+      if (emptyEntry == dirIndexEnd_) {
+        dirIndexState_ = DIR_INDEX_SEEN;
+        break;
+      }
+    }
+  }
+#endif  // SD_DIR_INDEX_SIZE
+  dirFile->rewind();
+
   // search for file
   while (dirFile->curPosition_ < dirFile->fileSize_) {
     uint8_t index = 0XF & (dirFile->curPosition_ >> 5);
@@ -413,6 +659,9 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
         emptyFound = true;
         dirIndex_ = index;
         dirBlock_ = SdVolume::cacheBlockNumber_;
+#if SD_DIR_INDEX_SIZE
+        emptyEntry = (dirFile->curPosition_ >> 5) - 1;
+#endif  // SD_DIR_INDEX_SIZE
       }
       // done if no entries follow
       if (p->name[0] == DIR_NAME_FREE) break;
@@ -427,19 +676,26 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
   // only create file if O_CREAT and O_WRITE
   if ((oflag & (O_CREAT | O_WRITE)) != (O_CREAT | O_WRITE)) return false;
 
+#if SD_DIR_INDEX_SIZE
+ create:
+#endif  // SD_DIR_INDEX_SIZE
   // cache found slot or add cluster if end of file
   if (emptyFound) {
     p = cacheDirEntry(SdVolume::CACHE_FOR_WRITE);
     if (!p) return false;
   } else {
     if (dirFile->type_ == FAT_FILE_TYPE_ROOT16) return false;
+#if SD_DIR_INDEX_SIZE
+    // new entry is first in the added cluster
+    emptyEntry = dirFile->fileSize_ >> 5;
+#endif  // SD_DIR_INDEX_SIZE
 
     // add and zero cluster for dirFile - first cluster is in cache for write
     if (!dirFile->addDirCluster()) return false;
 
     // use first entry in cluster
     dirIndex_ = 0;
-    p = SdVolume::cacheBuffer_.dir;
+    p = SdVolume::cacheBuffer_->dir;
   }
   // initialize as empty file
   memset(p, 0, sizeof(dir_t));
@@ -461,6 +717,13 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
   // force write of entry to SD
   if (!SdVolume::cacheFlush()) return false;
 
+#if SD_DIR_INDEX_SIZE
+  if (indexed && dirIndexState_ == DIR_INDEX_VALID) {
+    dirIndexAdd(hash, emptyEntry);
+    if (emptyEntry >= dirIndexEnd_) dirIndexEnd_ = emptyEntry + 1;
+  }
+#endif  // SD_DIR_INDEX_SIZE
+
   // open entry in cache
   return openCachedEntry(dirIndex_, oflag);
 }
@@ -504,10 +767,55 @@ uint8_t SdFile::open(SdFile* dirFile, uint16_t index, uint8_t oflag) {
   return openCachedEntry(index & 0XF, oflag);
 }
 //------------------------------------------------------------------------------
+/**
+ * Open a file or subdirectory from a known directory entry location.
+ *
+ * Used to reopen a file found by an earlier open() without searching
+ * its directory.  The entry must still hold \a fileName.
+ *
+ * \param[in] vol The volume containing the file.
+ * \param[in] block The block that holds the directory entry, see dirBlock().
+ * \param[in] index The index of the entry in \a block, see dirIndex().
+ * \param[in] fileName The DOS 8.3 name expected in the entry.
+ * \param[in] oflag Values for \a oflag are constructed by a
+ * bitwise-inclusive OR of flags O_READ, O_WRITE, O_TRUNC, and O_SYNC.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ * Reasons for failure include the entry no longer holds \a fileName,
+ * O_CREAT and O_EXCL are both set or an I/O error occurred.
+ */
+uint8_t SdFile::openEntry(SdVolume* vol, uint32_t block, uint8_t index,
+        const char* fileName, uint8_t oflag) {
+  uint8_t dname[11];
+
+  // error if already open
+  if (isOpen()) return false;
+
+  // don't open existing file if O_CREAT and O_EXCL - user call error
+  if ((oflag & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL)) return false;
+
+  if (!make83Name(fileName, dname)) return false;
+  vol_ = vol;
+
+  // read entry into cache
+  if (!SdVolume::cacheRawBlock(block,
+    SdVolume::CACHE_FOR_READ | SdVolume::CACHE_PIN_DIR)) {
+    return false;
+  }
+  // error if entry has been removed or reused
+  index &= 0XF;
+  if (memcmp(dname, SdVolume::cacheBuffer_->dir[index].name, 11)) {
+    return false;
+  }
+  // open cached entry
+  return openCachedEntry(index, oflag);
+}
+//------------------------------------------------------------------------------
 // open a cached directory entry. Assumes vol_ is initializes
 uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   // location of entry in cache
-  dir_t* p = SdVolume::cacheBuffer_.dir + dirIndex;
+  dir_t* p = SdVolume::cacheBuffer_->dir + dirIndex;
 
   // write or truncate is an error for a directory or read-only file
   if (p->attributes & (DIR_ATT_READ_ONLY | DIR_ATT_DIRECTORY)) {
@@ -537,6 +845,10 @@ uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   // set to start of file
   curCluster_ = 0;
   curPosition_ = 0;
+  logEndBlock_ = 0;
+#if SD_EXTENT_COUNT
+  extentClear();
+#endif  // SD_EXTENT_COUNT
 
   // truncate file to zero length if requested
   if (oflag & O_TRUNC) return truncate(0);
@@ -576,6 +888,10 @@ uint8_t SdFile::openRoot(SdVolume* vol) {
   // set to start of file
   curCluster_ = 0;
   curPosition_ = 0;
+  logEndBlock_ = 0;
+#if SD_EXTENT_COUNT
+  extentClear();
+#endif  // SD_EXTENT_COUNT
 
   // root has no directory entry
   dirBlock_ = 0;
@@ -669,6 +985,9 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
   // error if not open or write only
   if (!isOpen() || !(flags_ & O_READ)) return -1;
 
+  // card must be idle
+  if (!writeLogStop()) return -1;
+
   // max bytes left in file
   if (nbyte > (fileSize_ - curPosition_)) nbyte = fileSize_ - curPosition_;
 
@@ -690,6 +1009,9 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
           // get next cluster from FAT
           if (!vol_->fatGet(curCluster_, &curCluster_)) return -1;
         }
+#if SD_EXTENT_COUNT
+        extentNote(curPosition_ >> (vol_->clusterSizeShift_ + 9), curCluster_);
+#endif  // SD_EXTENT_COUNT
       }
       block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
     }
@@ -698,15 +1020,30 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
     // amount to be read from current block
     if (n > (512 - offset)) n = 512 - offset;
 
+#if SD_MULTIPLE_BLOCK_IO
+    if (offset == 0 && toRead >= 1024 && isFile() &&
+      SdVolume::cacheFind(block) == SdVolume::CACHE_NONE) {
+      // stream consecutive full blocks with one read command
+      int16_t count = readMultiple(block, dst, toRead >> 9);
+      if (count < 0) return -1;
+      n = 512 * count;
+      dst += n;
+      curPosition_ += n;
+      toRead -= n;
+      continue;
+    }
+#endif  // SD_MULTIPLE_BLOCK_IO
     // no buffering needed if n == 512 or user requests no buffering
     if ((unbufferedRead() || n == 512) &&
-      block != SdVolume::cacheBlockNumber_) {
+      SdVolume::cacheFind(block) == SdVolume::CACHE_NONE) {
       if (!vol_->readData(block, offset, n, dst)) return -1;
       dst += n;
     } else {
       // read block to cache and copy data to caller
-      if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) return -1;
-      uint8_t* src = SdVolume::cacheBuffer_.data + offset;
+      uint8_t action = isDir() ? SdVolume::CACHE_PIN_DIR
+                               : SdVolume::CACHE_FOR_READ;
+      if (!SdVolume::cacheRawBlock(block, action)) return -1;
+      uint8_t* src = SdVolume::cacheBuffer_->data + offset;
       uint8_t* end = src + n;
       while (src != end) *dst++ = *src++;
     }
@@ -716,6 +1053,39 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
   return nbyte;
 }
 //------------------------------------------------------------------------------
+#if SD_MULTIPLE_BLOCK_IO
+// Read up to maxCount full blocks starting at block, the block for the
+// current position.  The run ends at the first block that is not physically
+// next on the card or is in the cache.  Leaves curCluster_ at the cluster
+// of the last block read and returns the number of blocks read or -1.
+int16_t SdFile::readMultiple(uint32_t block,
+        uint8_t* dst, uint16_t maxCount) {
+  uint32_t cluster = curCluster_;
+  uint8_t blockOfCluster = vol_->blockOfCluster(curPosition_);
+  uint16_t count = 1;
+  while (count < maxCount) {
+    uint32_t next = cluster;
+    if (blockOfCluster == (vol_->blocksPerCluster_ - 1)) {
+      // next block is in the following cluster - must be adjacent
+      if (!vol_->fatGet(cluster, &next)) return -1;
+      if (next != (cluster + 1)) break;
+#if SD_EXTENT_COUNT
+      extentNote((curPosition_ + 512UL * count)
+                 >> (vol_->clusterSizeShift_ + 9), next);
+#endif  // SD_EXTENT_COUNT
+    }
+    // cached block may be newer than the card
+    if (SdVolume::cacheFind(block + count) != SdVolume::CACHE_NONE) break;
+    cluster = next;
+    blockOfCluster = (blockOfCluster + 1) & (vol_->blocksPerCluster_ - 1);
+    count++;
+  }
+  if (!vol_->readBlocks(block, count, dst)) return -1;
+  curCluster_ = cluster;
+  return count;
+}
+#endif  // SD_MULTIPLE_BLOCK_IO
+//------------------------------------------------------------------------------
 /**
  * Read the next directory entry from a directory file.
  *
@@ -760,7 +1130,7 @@ dir_t* SdFile::readDirCache(void) {
   curPosition_ += 31;
 
   // return pointer to entry
-  return (SdVolume::cacheBuffer_.dir + i);
+  return (SdVolume::cacheBuffer_->dir + i);
 }
 //------------------------------------------------------------------------------
 /**
@@ -778,6 +1148,12 @@ dir_t* SdFile::readDirCache(void) {
  * or an I/O error occurred.
  */
 uint8_t SdFile::remove(void) {
+#if SD_DIR_INDEX_SIZE
+  // a directory made later may reuse this one's first cluster
+  if (vol_ == dirIndexVol_ && firstCluster_ == dirIndexCluster_) {
+    dirIndexVol_ = NULL;
+  }
+#endif  // SD_DIR_INDEX_SIZE
   // free any clusters - will fail if read-only or directory
   if (!truncate(0)) return false;
 
@@ -923,6 +1299,9 @@ uint8_t SdFile::seekSet(uint32_t pos) {
   // error if file not open or seek past end of file
   if (!isOpen() || pos > fileSize_) return false;
 
+  // card must be idle
+  if (!writeLogStop()) return false;
+
   if (type_ == FAT_FILE_TYPE_ROOT16) {
     curPosition_ = pos;
     return true;
@@ -937,6 +1316,29 @@ uint8_t SdFile::seekSet(uint32_t pos) {
   uint32_t nCur = (curPosition_ - 1) >> (vol_->clusterSizeShift_ + 9);
   uint32_t nNew = (pos - 1) >> (vol_->clusterSizeShift_ + 9);
 
+#if SD_EXTENT_COUNT
+  if (nNew < extentEnd_) {
+    // cluster is in the extent table
+    curCluster_ = extentCluster(nNew);
+    curPosition_ = pos;
+    return true;
+  }
+  if ((nNew < nCur || curPosition_ == 0 || nCur < extentEnd_)
+    && extentEnd_) {
+    // follow chain from last cluster in the extent table
+    nCur = extentEnd_ - 1;
+    curCluster_ = extentCluster(nCur);
+  } else if (nNew < nCur || curPosition_ == 0) {
+    // must follow chain from first cluster
+    nCur = 0;
+    curCluster_ = firstCluster_;
+    extentNote(0, curCluster_);
+  }
+  while (nCur < nNew) {
+    if (!vol_->fatGet(curCluster_, &curCluster_)) return false;
+    extentNote(++nCur, curCluster_);
+  }
+#else  // SD_EXTENT_COUNT
   if (nNew < nCur || curPosition_ == 0) {
     // must follow chain from first cluster
     curCluster_ = firstCluster_;
@@ -947,6 +1349,7 @@ uint8_t SdFile::seekSet(uint32_t pos) {
   while (nNew--) {
     if (!vol_->fatGet(curCluster_, &curCluster_)) return false;
   }
+#endif  // SD_EXTENT_COUNT
   curPosition_ = pos;
   return true;
 }
@@ -964,6 +1367,9 @@ uint8_t SdFile::sync(void) {
   // only allow open files and directories
   if (!isOpen()) return false;
 
+  // end multiple block write so the directory entry can be updated
+  if (!writeLogStop()) return false;
+
   if (flags_ & F_FILE_DIR_DIRTY) {
     dir_t* d = cacheDirEntry(SdVolume::CACHE_FOR_WRITE);
     if (!d) return false;
@@ -1084,6 +1490,12 @@ uint8_t SdFile::truncate(uint32_t length) {
   // position to last cluster in truncated file
   if (!seekSet(length)) return false;
 
+  // chain is about to change
+  logEndBlock_ = 0;
+#if SD_EXTENT_COUNT
+  extentClear();
+#endif  // SD_EXTENT_COUNT
+
   if (length == 0) {
     // free all clusters
     if (!vol_->freeChain(firstCluster_)) return false;
@@ -1137,6 +1549,9 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
   // error if not a normal file or is read-only
   if (!isFile() || !(flags_ & O_WRITE)) goto writeErrorReturn;
 
+  // card must be idle
+  if (!writeLogStop()) goto writeErrorReturn;
+
   // seek to end of file if append flag
   if ((flags_ & O_APPEND) && curPosition_ != fileSize_) {
     if (!seekEnd()) goto writeErrorReturn;
@@ -1164,6 +1579,9 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
           curCluster_ = next;
         }
       }
+#if SD_EXTENT_COUNT
+      extentNote(curPosition_ >> (vol_->clusterSizeShift_ + 9), curCluster_);
+#endif  // SD_EXTENT_COUNT
     }
     // max space in block
     uint16_t n = 512 - blockOffset;
@@ -1173,27 +1591,35 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
 
     // block for data write
     uint32_t block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
+#if SD_MULTIPLE_BLOCK_IO
+    if (n == 512 && nToWrite >= 1024) {
+      // stream consecutive full blocks with one write command
+      int16_t count = writeMultiple(block, src, nToWrite >> 9);
+      if (count < 0) goto writeErrorReturn;
+      n = 512 * count;
+      src += n;
+      nToWrite -= n;
+      curPosition_ += n;
+      continue;
+    }
+#endif  // SD_MULTIPLE_BLOCK_IO
     if (n == 512) {
       // full block - don't need to use cache
       // invalidate cache if block is in cache
-      if (SdVolume::cacheBlockNumber_ == block) {
-        SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
-      }
+      SdVolume::cacheInvalidate(block);
       if (!vol_->writeBlock(block, src)) goto writeErrorReturn;
       src += 512;
     } else {
       if (blockOffset == 0 && curPosition_ >= fileSize_) {
         // start of new block don't need to read into cache
-        if (!SdVolume::cacheFlush()) goto writeErrorReturn;
-        SdVolume::cacheBlockNumber_ = block;
-        SdVolume::cacheSetDirty();
+        if (!SdVolume::cacheNewBlock(block)) goto writeErrorReturn;
       } else {
         // rewrite part of block
         if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) {
           goto writeErrorReturn;
         }
       }
-      uint8_t* dst = SdVolume::cacheBuffer_.data + blockOffset;
+      uint8_t* dst = SdVolume::cacheBuffer_->data + blockOffset;
       uint8_t* end = dst + n;
       while (dst != end) *dst++ = *src++;
     }
@@ -1221,6 +1647,135 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
   return 0;
 }
 //------------------------------------------------------------------------------
+#if SD_MULTIPLE_BLOCK_IO
+// Write up to maxCount full blocks starting at block, the block for the
+// current position.  Clusters are added to the file as the run crosses the
+// end of the chain and the run ends at the first cluster that is not
+// physically next on the card.  Leaves curCluster_ at the cluster of the
+// last block written and returns the number of blocks written or -1.
+int16_t SdFile::writeMultiple(uint32_t block,
+        const uint8_t* src, uint16_t maxCount) {
+  uint32_t cluster = curCluster_;
+  uint8_t blockOfCluster = vol_->blockOfCluster(curPosition_);
+  uint16_t count = 1;
+  while (count < maxCount) {
+    uint32_t next = cluster;
+    if (blockOfCluster == (vol_->blocksPerCluster_ - 1)) {
+      // next block is in the following cluster - must be adjacent
+      if (!vol_->fatGet(cluster, &next)) return -1;
+      if (vol_->isEOC(next)) {
+        // extend chain - a cluster that is not adjacent is used by write()
+        next = cluster;
+        if (!vol_->allocContiguous(1, &next)) break;
+      }
+      if (next != (cluster + 1)) break;
+#if SD_EXTENT_COUNT
+      extentNote((curPosition_ + 512UL * count)
+                 >> (vol_->clusterSizeShift_ + 9), next);
+#endif  // SD_EXTENT_COUNT
+    }
+    cluster = next;
+    blockOfCluster = (blockOfCluster + 1) & (vol_->blocksPerCluster_ - 1);
+    count++;
+  }
+  // cached copies are replaced by the data written
+  for (uint16_t i = 0; i < count; i++) SdVolume::cacheInvalidate(block + i);
+  if (!vol_->writeBlocks(block, count, src)) return -1;
+  curCluster_ = cluster;
+  return count;
+}
+#endif  // SD_MULTIPLE_BLOCK_IO
+//------------------------------------------------------------------------------
+/**
+ * Append a block to the contiguous space reserved for a log file.
+ *
+ * The first call starts a multiple block write that runs to the end of
+ * the file's clusters so each later call sends one block to the card with
+ * no FAT or directory access.  The file size is updated in memory and is
+ * written to the directory entry by sync() or close().  Any other access
+ * to the card ends the multiple block write and the next call starts a
+ * new one at the file's position.  The card is deselected between blocks
+ * so other SPI devices may be used.
+ *
+ * \param[in] buf Pointer to 512 bytes of data to be written.
+ *
+ * Blocks are written at the current position, or at the end of the file if
+ * it was opened with O_APPEND.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ * Reasons for failure include the file is not open for write, is not
+ * contiguous, the position is not a multiple of 512, the reserved space
+ * is full or an I/O error occurred.
+ */
+uint8_t SdFile::writeLog(const void* buf) {
+  uint32_t block;
+
+  // error if not a normal file or is read-only
+  if (!isFile() || !(flags_ & O_WRITE)) goto fail;
+
+  // seek to end of file if append flag
+  if ((flags_ & O_APPEND) && curPosition_ != fileSize_) {
+    if (!seekEnd()) goto fail;
+  }
+  // error if not at a block boundary
+  if (curPosition_ & 0X1FF) goto fail;
+
+  // find the reserved space if the file was not made by createLog()
+  if (logEndBlock_ == 0) {
+    uint32_t bgnBlock;
+    if (!contiguousRange(&bgnBlock, &logEndBlock_)) goto fail;
+  }
+  // error if reserved space is full
+  block = vol_->clusterStartBlock(firstCluster_) + (curPosition_ >> 9);
+  if (block > logEndBlock_) goto fail;
+
+  // start a stream unless ours is still open at this block
+  if (!(flags_ & F_FILE_LOG_STREAM) || !vol_->blockDevice()->isWriting(block)) {
+    // write dirty blocks before the card is busy
+    if (!SdVolume::cacheFlush()) goto fail;
+    if (!vol_->blockDevice()->writeStart(block, logEndBlock_ - block + 1)) {
+      goto fail;
+    }
+    flags_ |= F_FILE_LOG_STREAM;
+  }
+  // cached copy is replaced by the data written
+  SdVolume::cacheInvalidate(block);
+  if (!vol_->blockDevice()->writeData(reinterpret_cast<const uint8_t*>(buf))) {
+    flags_ &= ~F_FILE_LOG_STREAM;
+    goto fail;
+  }
+  curPosition_ += 512;
+
+  // space is contiguous so the current cluster follows from the position
+  curCluster_ = firstCluster_
+                + ((curPosition_ - 1) >> (vol_->clusterSizeShift_ + 9));
+  if (curPosition_ > fileSize_) {
+    fileSize_ = curPosition_;
+    flags_ |= F_FILE_DIR_DIRTY;
+  }
+  return true;
+
+ fail:
+  setWriteError();
+  return false;
+}
+//------------------------------------------------------------------------------
+/**
+ * End a multiple block write started by writeLog().
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdFile::writeLogStop(void) {
+  if (!(flags_ & F_FILE_LOG_STREAM)) return true;
+  flags_ &= ~F_FILE_LOG_STREAM;
+  // another access may have ended it or started a stream for another file
+  uint32_t block = vol_->clusterStartBlock(firstCluster_) + (curPosition_ >> 9);
+  if (!vol_->blockDevice()->isWriting(block)) return true;
+  return vol_->blockDevice()->writeStop();
+}
+//------------------------------------------------------------------------------
 /**
  * Write a byte to a file. Required by the Arduino Print class.
  *
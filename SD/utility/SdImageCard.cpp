@@ -0,0 +1,340 @@
+/* Arduino SdFat Library
+ * Copyright (C) 2009 by William Greiman
+ *
+ * This file is part of the Arduino SdFat Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "SdImageCard.h"
+#if defined(__linux__)
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+//------------------------------------------------------------------------------
+// SPI bytes for each part of a transfer, see Sd2Card.cpp
+/** select, wait not busy, six command bytes and R1 */
+uint8_t const WIRE_COMMAND = 8;
+/** start token, data and CRC */
+uint16_t const WIRE_READ_BLOCK = 1 + 512 + 2;
+/** start token, data, CRC and data response */
+uint16_t const WIRE_WRITE_BLOCK = 1 + 512 + 2 + 1;
+//------------------------------------------------------------------------------
+// values for state_
+uint8_t const IMAGE_IDLE = 0;
+uint8_t const IMAGE_READ = 1;
+uint8_t const IMAGE_WRITE = 2;
+//------------------------------------------------------------------------------
+/** Construct an instance of SdImageCard.  Call begin() to open an image. */
+SdImageCard::SdImageCard(void) : blockCount_(0), data_(NULL), fd_(-1),
+  state_(IMAGE_IDLE), trace_(NULL) {
+  setTiming(4000000, 150, 800);
+  statsClear();
+}
+//------------------------------------------------------------------------------
+/**
+ * Open a disk image.
+ *
+ * \param[in] path Image file to map or NULL for an image held in RAM.
+ *
+ * \param[in] blockCount Minimum size in blocks.  A file is created or
+ * extended to this size.  Zero uses the size of an existing file.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::begin(const char* path, uint32_t blockCount) {
+  struct stat st;
+  end();
+  if (path) {
+    fd_ = open(path, blockCount ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    if (fd_ < 0) goto fail;
+    if (fstat(fd_, &st)) goto fail;
+    if ((uint64_t)st.st_size < 512ULL * blockCount) {
+      if (ftruncate(fd_, 512ULL * blockCount)) goto fail;
+    } else {
+      blockCount = st.st_size >> 9;
+    }
+  }
+  if (blockCount == 0) goto fail;
+  data_ = (uint8_t*)mmap(NULL, 512ULL * blockCount, PROT_READ | PROT_WRITE,
+    fd_ < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED, fd_, 0);
+  if (data_ == MAP_FAILED) {
+    data_ = NULL;
+    goto fail;
+  }
+  blockCount_ = blockCount;
+  return true;
+
+ fail:
+  end();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Unmap the image.  Blocks written to an image file are saved. */
+void SdImageCard::end(void) {
+  if (data_) munmap(data_, 512ULL * blockCount_);
+  if (fd_ >= 0) close(fd_);
+  data_ = NULL;
+  fd_ = -1;
+  blockCount_ = 0;
+  state_ = IMAGE_IDLE;
+}
+//------------------------------------------------------------------------------
+// count a command, wait for the card as Sd2Card::cardCommand() does
+void SdImageCard::command(uint8_t cmd, uint32_t arg) {
+  waitNotBusy();
+  if (trace_) {
+    fprintf(trace_, "%llu CMD%u %lu\n",
+      (unsigned long long)(nanos_ / 1000), cmd, (unsigned long)arg);
+  }
+  transfer(WIRE_COMMAND);
+}
+//------------------------------------------------------------------------------
+// end an open multiple block write as Sd2Card::cardCommand() does
+uint8_t SdImageCard::idle(void) {
+  if (state_ == IMAGE_WRITE) writeStop();
+  return state_ == IMAGE_IDLE;
+}
+//------------------------------------------------------------------------------
+/**
+ * Check for busy.  Takes the time to receive one byte from the card.
+ *
+ * \return true if busy, false if not busy.
+ */
+uint8_t SdImageCard::isBusy(void) {
+  transfer(1);
+  return nanos_ < busyUntil_;
+}
+//------------------------------------------------------------------------------
+/**
+ * \return true if a multiple block write is open and \a blockNumber
+ * is the next block it will write.
+ */
+uint8_t SdImageCard::isWriting(uint32_t blockNumber) {
+  return state_ == IMAGE_WRITE && block_ == blockNumber;
+}
+//------------------------------------------------------------------------------
+/**
+ * Read a 512 byte block.  Counted as CMD17.
+ *
+ * \param[in] block Logical block to be read.
+ * \param[out] dst Pointer to the location that will receive the data.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::readBlock(uint32_t block, uint8_t* dst) {
+  return readData(block, 0, 512, dst);
+}
+//------------------------------------------------------------------------------
+/**
+ * Read part of a 512 byte block.  The whole block is sent by the card
+ * as Sd2Card does with partial block reads disabled.
+ *
+ * \param[in] block Logical block to be read.
+ * \param[in] offset Number of bytes to skip at start of block
+ * \param[out] dst Pointer to the location that will receive the data.
+ * \param[in] count Number of bytes to read
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::readData(uint32_t block,
+        uint16_t offset, uint16_t count, uint8_t* dst) {
+  if (!idle() || block >= blockCount_) return false;
+  if (count == 0 || (offset + count) > 512) return false;
+  command(17, block);
+  nanos_ += 1000ULL * readMicros_;
+  transfer(WIRE_READ_BLOCK);
+  memcpy(dst, data_ + 512ULL * block + offset, count);
+  stats_.cmd17++;
+  stats_.blocksRead++;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Read the next block of a multiple block read.
+ *
+ * \param[out] dst Pointer to the location for the data to be read.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::readData(uint8_t* dst) {
+  if (state_ != IMAGE_READ || block_ >= blockCount_) return false;
+  nanos_ += 1000ULL * readMicros_;
+  transfer(WIRE_READ_BLOCK);
+  memcpy(dst, data_ + 512ULL * block_++, 512);
+  stats_.blocksRead++;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Start a multiple block read.  Counted as CMD18.
+ *
+ * \param[in] blockNumber Address of first block in sequence.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::readStart(uint32_t blockNumber) {
+  if (!idle() || blockNumber >= blockCount_) return false;
+  command(18, blockNumber);
+  block_ = blockNumber;
+  state_ = IMAGE_READ;
+  stats_.cmd18++;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * End a multiple block read.  CMD12 and its stuff byte are added to the
+ * wire time.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::readStop(void) {
+  if (state_ != IMAGE_READ) return false;
+  command(12, 0);
+  transfer(1);
+  state_ = IMAGE_IDLE;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Set the model used for SD card time.
+ *
+ * \param[in] sckHz SPI clock rate.  The default is 4 MHz, SPI_HALF_SPEED
+ * on a 16 MHz AVR.
+ * \param[in] readMicros Card access time before each block is sent.
+ * \param[in] writeMicros Card busy time after each block is written.
+ */
+void SdImageCard::setTiming(uint32_t sckHz,
+  uint16_t readMicros, uint16_t writeMicros) {
+  sckHz_ = sckHz ? sckHz : 1;
+  readMicros_ = readMicros;
+  writeMicros_ = writeMicros;
+}
+//------------------------------------------------------------------------------
+/** Set counters and the modelled clock to zero. */
+void SdImageCard::statsClear(void) {
+  memset(&stats_, 0, sizeof(stats_));
+  nanos_ = 0;
+  busyUntil_ = 0;
+}
+//------------------------------------------------------------------------------
+// advance the modelled clock by the time to send bytes on the SPI bus
+void SdImageCard::transfer(uint32_t bytes) {
+  stats_.wireBytes += bytes;
+  nanos_ += 8000000000ULL * bytes / sckHz_;
+  stats_.micros = nanos_ / 1000;
+}
+//------------------------------------------------------------------------------
+// poll until the card has programmed the last block written
+void SdImageCard::waitNotBusy(void) {
+  if (nanos_ < busyUntil_) {
+    uint64_t wait = busyUntil_ - nanos_;
+    stats_.busyMicros += wait / 1000;
+    stats_.wireBytes += wait * sckHz_ / 8000000000ULL;
+    nanos_ = busyUntil_;
+    stats_.micros = nanos_ / 1000;
+  }
+}
+//------------------------------------------------------------------------------
+/**
+ * Write a 512 byte block.  Counted as CMD24.  The card is polled until the
+ * block is programmed and CMD13 checks the status as in Sd2Card.
+ *
+ * \param[in] blockNumber Logical block to be written.
+ * \param[in] src Pointer to the location of the data to be written.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::writeBlock(uint32_t blockNumber, const uint8_t* src) {
+  if (!idle() || blockNumber >= blockCount_) return false;
+  command(24, blockNumber);
+  transfer(WIRE_WRITE_BLOCK);
+  memcpy(data_ + 512ULL * blockNumber, src, 512);
+  busyUntil_ = nanos_ + 1000ULL * writeMicros_;
+  waitNotBusy();
+  command(13, 0);
+  transfer(1);
+  stats_.cmd24++;
+  stats_.blocksWritten++;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Write one data block in a multiple block write sequence.
+ *
+ * \param[in] src Pointer to the location of the data to be written.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::writeData(const uint8_t* src) {
+  if (state_ != IMAGE_WRITE || block_ >= blockCount_) return false;
+  waitNotBusy();
+  transfer(WIRE_WRITE_BLOCK);
+  memcpy(data_ + 512ULL * block_++, src, 512);
+  busyUntil_ = nanos_ + 1000ULL * writeMicros_;
+  streamCount_++;
+  stats_.blocksWritten++;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Start a write multiple blocks sequence.  Counted as CMD25 and the
+ * ACMD23 pre-erase command is added to the wire time.
+ *
+ * \param[in] blockNumber Address of first block in sequence.
+ * \param[in] eraseCount The number of blocks to be pre-erased.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
+  if (!idle() || blockNumber >= blockCount_) return false;
+  command(55, 0);
+  command(23, eraseCount);
+  command(25, blockNumber);
+  block_ = blockNumber;
+  streamCount_ = 0;
+  state_ = IMAGE_WRITE;
+  stats_.cmd25++;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * End a write multiple blocks sequence.  Does nothing if none is open.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t SdImageCard::writeStop(void) {
+  if (state_ != IMAGE_WRITE) return true;
+  waitNotBusy();
+  transfer(1);
+  if (trace_) {
+    fprintf(trace_, "%llu STOP_TRAN %lu\n",
+      (unsigned long long)(nanos_ / 1000), (unsigned long)streamCount_);
+  }
+  state_ = IMAGE_IDLE;
+  return true;
+}
+#endif  // defined(__linux__)
@@ -0,0 +1,117 @@
+/* Arduino SdFat Library
+ * Copyright (C) 2009 by William Greiman
+ *
+ * This file is part of the Arduino SdFat Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef SdImageCard_h
+#define SdImageCard_h
+/**
+ * \file
+ * SdImageCard class
+ */
+#include "SdBlockDevice.h"
+#if defined(__linux__)
+#include <stdio.h>
+//------------------------------------------------------------------------------
+/**
+ * \struct SdImageStats
+ * \brief Commands, blocks and modelled SPI time counted by SdImageCard.
+ */
+struct SdImageStats {
+  /** CMD17 single block reads, including partial block reads */
+  uint32_t cmd17;
+  /** CMD18 multiple block reads */
+  uint32_t cmd18;
+  /** CMD24 single block writes */
+  uint32_t cmd24;
+  /** CMD25 multiple block writes */
+  uint32_t cmd25;
+  /** blocks transferred from the device */
+  uint32_t blocksRead;
+  /** blocks transferred to the device */
+  uint32_t blocksWritten;
+  /** bytes that would be clocked over the SPI bus */
+  uint64_t wireBytes;
+  /** modelled time waiting for the card to program blocks */
+  uint64_t busyMicros;
+  /** modelled time since the last statsClear() */
+  uint64_t micros;
+};
+//------------------------------------------------------------------------------
+/**
+ * \class SdImageCard
+ * \brief SdBlockDevice backed by a disk image file or RAM on a Linux host.
+ *
+ * The image is mapped with mmap() so blocks are copied straight to and
+ * from the file.  Each command is counted and its cost on an SD card is
+ * modelled from the number of bytes sent on the SPI bus, the SCK rate and
+ * a fixed programming time for each block written.  A line is written to
+ * the trace file, if set, for each command.
+ *
+ * Only the device is host code.  The rest of the library is built with
+ * the Arduino headers it normally uses or with host stand-ins for them.
+ */
+class SdImageCard : public SdBlockDevice {
+ public:
+  SdImageCard(void);
+  ~SdImageCard(void) {end();}
+  uint8_t begin(const char* path, uint32_t blockCount = 0);
+  /** \return Pointer to the mapped image or NULL if not open. */
+  uint8_t* data(void) const {return data_;}
+  void end(void);
+  /** \return Statistics since the last call to statsClear(). */
+  const SdImageStats& stats(void) const {return stats_;}
+  void statsClear(void);
+  void setTiming(uint32_t sckHz, uint16_t readMicros, uint16_t writeMicros);
+  /** Write one line for each command to \a file.  NULL stops the trace. */
+  void setTrace(FILE* file) {trace_ = file;}
+
+  uint32_t cardSize(void) {return blockCount_;}
+  uint8_t isBusy(void);
+  uint8_t isWriting(uint32_t blockNumber);
+  uint8_t readBlock(uint32_t block, uint8_t* dst);
+  uint8_t readData(uint32_t block,
+          uint16_t offset, uint16_t count, uint8_t* dst);
+  uint8_t readData(uint8_t* dst);
+  uint8_t readStart(uint32_t blockNumber);
+  uint8_t readStop(void);
+  uint8_t writeBlock(uint32_t blockNumber, const uint8_t* src);
+  uint8_t writeData(const uint8_t* src);
+  uint8_t writeStart(uint32_t blockNumber, uint32_t eraseCount);
+  uint8_t writeStop(void);
+ private:
+  uint32_t block_;           // next block of a multiple block transfer
+  uint32_t blockCount_;      // size of the image in blocks
+  uint64_t busyUntil_;       // nanoseconds when programming is done
+  uint8_t* data_;            // mapped image
+  int fd_;                   // image file or -1 for RAM
+  uint64_t nanos_;           // modelled time
+  uint16_t readMicros_;      // card access time before a read block
+  uint32_t sckHz_;           // modelled SPI clock
+  uint8_t state_;            // multiple block transfer in progress
+  SdImageStats stats_;
+  uint32_t streamCount_;     // blocks in current multiple block transfer
+  FILE* trace_;
+  uint16_t writeMicros_;     // time to program one block
+
+  void command(uint8_t cmd, uint32_t arg);
+  uint8_t idle(void);
+  void transfer(uint32_t bytes);
+  void waitNotBusy(void);
+};
+#endif  // defined(__linux__)
+#endif  // SdImageCard_h
@@ -20,12 +20,19 @@
 #include <SdFat.h>
 //------------------------------------------------------------------------------
 // raw block cache
+cache_t  SdVolume::cacheBlock_[SD_CACHE_BLOCK_COUNT];   // 512 byte blocks
+uint32_t SdVolume::cacheNumber_[SD_CACHE_BLOCK_COUNT];  // block in each entry
+uint32_t SdVolume::cacheMirror_[SD_CACHE_BLOCK_COUNT];  // mirror FAT block
+uint8_t  SdVolume::cacheState_[SD_CACHE_BLOCK_COUNT];   // all entries invalid
+uint8_t  SdVolume::cacheAge_[SD_CACHE_BLOCK_COUNT];     // LRU age of entries
+uint8_t  SdVolume::cacheCurrent_ = 0;   // entry last accessed
+cache_t* SdVolume::cacheBuffer_ = SdVolume::cacheBlock_;
 // init cacheBlockNumber_to invalid SD block number
 uint32_t SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
-cache_t  SdVolume::cacheBuffer_;     // 512 byte cache for Sd2Card
-Sd2Card* SdVolume::sdCard_;          // pointer to SD card object
-uint8_t  SdVolume::cacheDirty_ = 0;  // cacheFlush() will write block if true
-uint32_t SdVolume::cacheMirrorBlock_ = 0;  // mirror  block for second FAT
+uint32_t SdVolume::cacheHitCount_ = 0;
+uint32_t SdVolume::cacheMissCount_ = 0;
+uint32_t SdVolume::cacheFlushCount_ = 0;
+SdBlockDevice* SdVolume::sdCard_;    // pointer to block device
 //------------------------------------------------------------------------------
 // find a contiguous group of clusters
 uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
@@ -55,6 +62,14 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   // last cluster of FAT
   uint32_t fatEnd = clusterCount_ + 1;
 
+#if SD_FREE_MAP_BYTES
+  // true if the scan covers the current group from its first cluster
+  uint8_t groupScan = false;
+
+  // true if a free cluster was found in the current group
+  uint8_t groupFree = false;
+#endif  // SD_FREE_MAP_BYTES
+
   // search the FAT for free clusters
   for (uint32_t n = 0;; n++, endCluster++) {
     // can't find space checked all clusters
@@ -64,6 +79,22 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
     if (endCluster > fatEnd) {
       bgnCluster = endCluster = 2;
     }
+#if SD_FREE_MAP_BYTES
+    uint32_t groupMask = (1UL << freeMapShift_) - 1;
+    uint32_t groupEnd = endCluster | groupMask;
+    if (freeMapIsFull(endCluster)) {
+      // skip to the last cluster of a full group
+      n += groupEnd - endCluster;
+      endCluster = groupEnd;
+      bgnCluster = endCluster + 1;
+      continue;
+    }
+    if ((endCluster & groupMask) == 0 || endCluster == 2) {
+      // first cluster of a group
+      groupScan = true;
+      groupFree = false;
+    }
+#endif  // SD_FREE_MAP_BYTES
     uint32_t f;
     if (!fatGet(endCluster, &f)) return false;
 
@@ -74,6 +105,15 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
       // done - found space
       break;
     }
+#if SD_FREE_MAP_BYTES
+    if (f == 0) groupFree = true;
+
+    // remember a group with no free clusters
+    if ((endCluster == groupEnd || endCluster == fatEnd)
+      && groupScan && !groupFree) {
+      freeMapSetFull(endCluster);
+    }
+#endif  // SD_FREE_MAP_BYTES
   }
   // mark end of chain
   if (!fatPutEOC(endCluster)) return false;
@@ -96,43 +136,121 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   return true;
 }
 //------------------------------------------------------------------------------
+// return index of the entry that holds blockNumber or CACHE_NONE
+uint8_t SdVolume::cacheFind(uint32_t blockNumber) {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCK_COUNT; i++) {
+    if ((cacheState_[i] & CACHE_STATE_VALID)
+      && cacheNumber_[i] == blockNumber) {
+      return i;
+    }
+  }
+  return CACHE_NONE;
+}
+//------------------------------------------------------------------------------
+// write all dirty blocks to the device
 uint8_t SdVolume::cacheFlush(void) {
-  if (cacheDirty_) {
-    if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data)) {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCK_COUNT; i++) {
+    if (!cacheFlushEntry(i)) return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// write one entry to the device if it is dirty
+uint8_t SdVolume::cacheFlushEntry(uint8_t i) {
+  if (cacheState_[i] & CACHE_FOR_WRITE) {
+    if (!sdCard_->writeBlock(cacheNumber_[i], cacheBlock_[i].data)) {
       return false;
     }
     // mirror FAT tables
-    if (cacheMirrorBlock_) {
-      if (!sdCard_->writeBlock(cacheMirrorBlock_, cacheBuffer_.data)) {
+    if (cacheMirror_[i]) {
+      if (!sdCard_->writeBlock(cacheMirror_[i], cacheBlock_[i].data)) {
         return false;
       }
-      cacheMirrorBlock_ = 0;
+      cacheMirror_[i] = 0;
     }
-    cacheDirty_ = 0;
+    cacheState_[i] &= ~CACHE_FOR_WRITE;
+    cacheFlushCount_++;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// drop a block that is about to be overwritten on the device
+void SdVolume::cacheInvalidate(uint32_t blockNumber) {
+  uint8_t i = cacheFind(blockNumber);
+  if (i == CACHE_NONE) return;
+  cacheState_[i] = 0;
+  cacheMirror_[i] = 0;
+  if (i == cacheCurrent_) cacheBlockNumber_ = 0XFFFFFFFF;
+}
+//------------------------------------------------------------------------------
+// cache blockNumber for write without reading it from the device
+uint8_t SdVolume::cacheNewBlock(uint32_t blockNumber) {
+  uint8_t i = cacheFind(blockNumber);
+  if (i == CACHE_NONE) {
+    i = cacheVictim();
+    if (!cacheFlushEntry(i)) return false;
+    cacheNumber_[i] = blockNumber;
   }
+  cacheState_[i] = CACHE_STATE_VALID | CACHE_FOR_WRITE;
+  cacheUse(i);
   return true;
 }
 //------------------------------------------------------------------------------
 uint8_t SdVolume::cacheRawBlock(uint32_t blockNumber, uint8_t action) {
-  if (cacheBlockNumber_ != blockNumber) {
-    if (!cacheFlush()) return false;
-    if (!sdCard_->readBlock(blockNumber, cacheBuffer_.data)) return false;
-    cacheBlockNumber_ = blockNumber;
+  uint8_t i = cacheBlockNumber_ == blockNumber ?
+              cacheCurrent_ : cacheFind(blockNumber);
+  if (i == CACHE_NONE) {
+    i = cacheVictim();
+    if (!cacheFlushEntry(i)) return false;
+
+    // entry is invalid until the read succeeds
+    cacheState_[i] = 0;
+    if (i == cacheCurrent_) cacheBlockNumber_ = 0XFFFFFFFF;
+    if (!sdCard_->readBlock(blockNumber, cacheBlock_[i].data)) return false;
+    cacheNumber_[i] = blockNumber;
+    cacheState_[i] = CACHE_STATE_VALID;
+    cacheMissCount_++;
+  } else {
+    cacheHitCount_++;
   }
-  cacheDirty_ |= action;
+  cacheState_[i] |= action;
+  cacheUse(i);
   return true;
 }
 //------------------------------------------------------------------------------
+// make entry i the current entry and the most recently used
+void SdVolume::cacheUse(uint8_t i) {
+  for (uint8_t j = 0; j < SD_CACHE_BLOCK_COUNT; j++) {
+    if (cacheAge_[j] != 0XFF) cacheAge_[j]++;
+  }
+  cacheAge_[i] = 0;
+  cacheCurrent_ = i;
+  cacheBuffer_ = &cacheBlock_[i];
+  cacheBlockNumber_ = cacheState_[i] & CACHE_STATE_VALID ?
+                      cacheNumber_[i] : 0XFFFFFFFF;
+}
+//------------------------------------------------------------------------------
+// select the entry to replace - an empty entry, else the least recently
+// used entry with the lowest pin level
+uint8_t SdVolume::cacheVictim(void) {
+  uint8_t v = 0;
+  for (uint8_t i = 0; i < SD_CACHE_BLOCK_COUNT; i++) {
+    if (!(cacheState_[i] & CACHE_STATE_VALID)) return i;
+    uint8_t pin = cacheState_[i] & CACHE_PIN_MASK;
+    uint8_t vPin = cacheState_[v] & CACHE_PIN_MASK;
+    if (pin < vPin || (pin == vPin && cacheAge_[i] > cacheAge_[v])) v = i;
+  }
+  return v;
+}
+//------------------------------------------------------------------------------
 // cache a zero block for blockNumber
 uint8_t SdVolume::cacheZeroBlock(uint32_t blockNumber) {
-  if (!cacheFlush()) return false;
+  if (!cacheNewBlock(blockNumber)) return false;
 
-  // loop take less flash than memset(cacheBuffer_.data, 0, 512);
+  // loop take less flash than memset(cacheBuffer_->data, 0, 512);
   for (uint16_t i = 0; i < 512; i++) {
-    cacheBuffer_.data[i] = 0;
+    cacheBuffer_->data[i] = 0;
   }
-  cacheBlockNumber_ = blockNumber;
-  cacheSetDirty();
   return true;
 }
 //------------------------------------------------------------------------------
@@ -152,13 +270,11 @@ uint8_t SdVolume::fatGet(uint32_t cluster, uint32_t* value) const {
   if (cluster > (clusterCount_ + 1)) return false;
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
-  if (lba != cacheBlockNumber_) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) return false;
-  }
+  if (!cacheRawBlock(lba, CACHE_PIN_FAT)) return false;
   if (fatType_ == 16) {
-    *value = cacheBuffer_.fat16[cluster & 0XFF];
+    *value = cacheBuffer_->fat16[cluster & 0XFF];
   } else {
-    *value = cacheBuffer_.fat32[cluster & 0X7F] & FAT32MASK;
+    *value = cacheBuffer_->fat32[cluster & 0X7F] & FAT32MASK;
   }
   return true;
 }
@@ -175,19 +291,21 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
 
-  if (lba != cacheBlockNumber_) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) return false;
-  }
+  if (!cacheRawBlock(lba, CACHE_FOR_WRITE | CACHE_PIN_FAT)) return false;
+
   // store entry
   if (fatType_ == 16) {
-    cacheBuffer_.fat16[cluster & 0XFF] = value;
+    cacheBuffer_->fat16[cluster & 0XFF] = value;
   } else {
-    cacheBuffer_.fat32[cluster & 0X7F] = value;
+    cacheBuffer_->fat32[cluster & 0X7F] = value;
   }
-  cacheSetDirty();
-
   // mirror second FAT
-  if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
+  if (fatCount_ > 1) cacheMirror_[cacheCurrent_] = lba + blocksPerFat_;
+
+#if SD_FREE_MAP_BYTES
+  // group has a free cluster
+  if (value == 0) freeMapSetFree(cluster);
+#endif  // SD_FREE_MAP_BYTES
   return true;
 }
 //------------------------------------------------------------------------------
@@ -209,10 +327,25 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
   return true;
 }
 //------------------------------------------------------------------------------
+// read count consecutive blocks with one multiple block read command
+uint8_t SdVolume::readBlocks(uint32_t block, uint16_t count, uint8_t* dst) {
+  if (count == 1) return sdCard_->readBlock(block, dst);
+  if (!sdCard_->readStart(block)) return false;
+  for (uint16_t i = 0; i < count; i++, dst += 512) {
+    if (!sdCard_->readData(dst)) {
+      // the card keeps sending blocks until CMD12
+      sdCard_->readStop();
+      return false;
+    }
+  }
+  return sdCard_->readStop();
+}
+//------------------------------------------------------------------------------
 /**
  * Initialize a FAT volume.
  *
- * \param[in] dev The SD card where the volume is located.
+ * \param[in] dev The SD card or other block device where the volume
+ * is located.
  *
  * \param[in] part The partition to be used.  Legal values for \a part are
  * 1-4 to use the corresponding partition on a device formatted with
@@ -224,15 +357,26 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
  * failure include not finding a valid partition, not finding a valid
  * FAT file system in the specified partition or an I/O error.
  */
-uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
+uint8_t SdVolume::init(SdBlockDevice* dev, uint8_t part) {
   uint32_t volumeStartBlock = 0;
-  sdCard_ = dev;
+#if SD_DIR_INDEX_SIZE
+  // the card may have been changed or rewritten since the index was built
+  SdFile::dirIndexVol_ = NULL;
+#endif  // SD_DIR_INDEX_SIZE
+  if (dev != sdCard_) {
+    // write blocks cached from another device back to it
+    cacheFlush();
+    sdCard_ = dev;
+  }
+  // the card may have been changed, drop cached blocks without writing them
+  for (uint8_t i = 0; i < SD_CACHE_BLOCK_COUNT; i++) cacheState_[i] = 0;
+  cacheUse(0);
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
     if (part > 4)return false;
     if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) return false;
-    part_t* p = &cacheBuffer_.mbr.part[part-1];
+    part_t* p = &cacheBuffer_->mbr.part[part-1];
     if ((p->boot & 0X7F) !=0  ||
       p->totalSectors < 100 ||
       p->firstSector == 0) {
@@ -242,7 +386,7 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
     volumeStartBlock = p->firstSector;
   }
   if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) return false;
-  bpb_t* bpb = &cacheBuffer_.fbs.bpb;
+  bpb_t* bpb = &cacheBuffer_->fbs.bpb;
   if (bpb->bytesPerSector != 512 ||
     bpb->fatCount == 0 ||
     bpb->reservedSectorCount == 0 ||
@@ -291,5 +435,31 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
     rootDirStart_ = bpb->fat32RootCluster;
     fatType_ = 32;
   }
+  allocSearchStart_ = 2;
+
+#if SD_FREE_MAP_BYTES
+  // smallest group of whole FAT blocks that fits the map
+  freeMapShift_ = fatType_ == 16 ? 8 : 7;
+  while (((clusterCount_ + 1) >> freeMapShift_) >= 8 * SD_FREE_MAP_BYTES) {
+    freeMapShift_++;
+  }
+  // nothing known about free space
+  for (uint8_t i = 0; i < SD_FREE_MAP_BYTES; i++) freeMap_[i] = 0;
+#endif  // SD_FREE_MAP_BYTES
   return true;
 }
+//------------------------------------------------------------------------------
+// write count consecutive blocks with one multiple block write command
+uint8_t SdVolume::writeBlocks(uint32_t block, uint16_t count,
+  const uint8_t* src) {
+  if (count == 1) return sdCard_->writeBlock(block, src);
+  if (!sdCard_->writeStart(block, count)) return false;
+  for (uint16_t i = 0; i < count; i++, src += 512) {
+    if (!sdCard_->writeData(src)) {
+      // the card waits for more blocks until the stop token
+      sdCard_->writeStop();
+      return false;
+    }
+  }
+  return sdCard_->writeStop();
+}
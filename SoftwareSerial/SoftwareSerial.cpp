@@ -129,6 +129,10 @@ const int XMIT_START_ADJUSTMENT = 6;
 
 #endif
 
+#if _SS_TIMER_RX && !defined(TIMER2_COMPA_vect)
+#error _SS_TIMER_RX needs Timer2 with two compare units
+#endif
+
 //
 // Statics
 //
@@ -136,6 +140,14 @@ SoftwareSerial *SoftwareSerial::active_object = 0;
 char SoftwareSerial::_receive_buffer[_SS_MAX_RX_BUFF]; 
 volatile uint8_t SoftwareSerial::_receive_buffer_tail = 0;
 volatile uint8_t SoftwareSerial::_receive_buffer_head = 0;
+#if _SS_TIMER_RX
+volatile uint8_t SoftwareSerial::_rx_bits = 0;
+uint8_t SoftwareSerial::_rx_byte;
+uint16_t SoftwareSerial::_rx_when;
+volatile uint8_t SoftwareSerial::_tx_bits = 0;
+uint16_t SoftwareSerial::_tx_frame;
+uint16_t SoftwareSerial::_tx_when;
+#endif
 
 //
 // Debugging
@@ -180,9 +192,17 @@ bool SoftwareSerial::listen()
 {
   if (active_object != this)
   {
+#if _SS_TIMER_RX
+    // the last object's character goes out first
+    while (_tx_bits)
+      ;
+#endif
     _buffer_overflow = false;
     uint8_t oldSREG = SREG;
     cli();
+#if _SS_TIMER_RX
+    setTimer();
+#endif
     _receive_buffer_head = _receive_buffer_tail = 0;
     active_object = this;
     SREG = oldSREG;
@@ -192,11 +212,40 @@ bool SoftwareSerial::listen()
   return false;
 }
 
+#if _SS_TIMER_RX
+// Runs Timer2 free at this object's clock, giving up any character half
+// received.  Called with interrupts off.
+void SoftwareSerial::setTimer()
+{
+  if (_rx_bits)
+    *active_object->_pcint_maskreg |= active_object->_pcint_maskvalue;
+  _rx_bits = _tx_bits = 0;
+  TIMSK2 &= ~(_BV(OCIE2A) | _BV(OCIE2B));
+  TCCR2A = 0;
+  TCCR2B = _timer_clock;
+}
+#endif
+
 //
 // The receive routine called by the interrupt handler
 //
 void SoftwareSerial::recv()
 {
+#if _SS_TIMER_RX
+  // Only the start bit is found here, the timer samples the character.
+  // Its pin change interrupts are off until the stop bit.
+  uint8_t now = TCNT2;
+
+  if (!_rx_bits && (_inverse_logic ? rx_pin_read() : !rx_pin_read()))
+  {
+    *_pcint_maskreg &= ~_pcint_maskvalue;
+    _rx_when = ((uint16_t)now << 8) + _rx_start_ticks;
+    OCR2A = _rx_when >> 8;
+    TIFR2 = _BV(OCF2A);
+    TIMSK2 |= _BV(OCIE2A);
+    _rx_bits = _rx_start_bits;
+  }
+#else
 
 #if GCC_VERSION < 40302
 // Work-around for avr-gcc 4.3.0 OSX version bug
@@ -273,6 +322,7 @@ void SoftwareSerial::recv()
     "pop r18 \n\t"
     ::);
 #endif
+#endif
 }
 
 void SoftwareSerial::tx_pin_write(uint8_t pin_state)
@@ -301,6 +351,86 @@ inline void SoftwareSerial::handle_interrupt()
   }
 }
 
+#if _SS_TIMER_RX
+// One bit of the character coming in, sampled at its middle: the start
+// bit, 8 data bits, then the stop bit.  At 115200 baud the start bit
+// isn't sampled.
+/* static */
+inline void SoftwareSerial::handle_rx_timer()
+{
+  SoftwareSerial *o = active_object;
+  uint8_t mark = o->_inverse_logic ? !o->rx_pin_read() : o->rx_pin_read();
+  uint8_t bits = --_rx_bits;
+
+  if (bits == 9)
+  {
+    // a start bit that has gone was a glitch
+    if (mark)
+      bits = _rx_bits = 0;
+  }
+  else if (bits)
+  {
+    _rx_byte = (_rx_byte >> 1) | (mark ? 0x80 : 0);
+  }
+  else if (mark)
+  {
+    // if buffer full, set the overflow flag
+    if ((_receive_buffer_tail + 1) % _SS_MAX_RX_BUFF != _receive_buffer_head) 
+    {
+      _receive_buffer[_receive_buffer_tail] = _rx_byte;
+      _receive_buffer_tail = (_receive_buffer_tail + 1) % _SS_MAX_RX_BUFF;
+    }
+    else
+      o->_buffer_overflow = true;
+  }
+  // else no stop bit, a framing error: the character is dropped
+
+  if (bits)
+  {
+    _rx_when += o->_bit_ticks;
+    // the stop bit a quarter bit early, for a sender that runs fast and
+    // samples that other interrupts have held up
+    if (bits == 1)
+      _rx_when -= o->_bit_ticks >> 2;
+    OCR2A = _rx_when >> 8;
+  }
+  else
+  {
+    // wait for the next start bit
+    TIMSK2 &= ~_BV(OCIE2A);
+    *o->_pcint_maskreg |= o->_pcint_maskvalue;
+  }
+}
+
+// The next bit of the character going out: 8 data bits, the stop bit, then
+// the end of the stop bit
+/* static */
+inline void SoftwareSerial::handle_tx_timer()
+{
+  SoftwareSerial *o = active_object;
+
+  if (--_tx_bits)
+  {
+    o->tx_pin_write((_tx_frame & 1) != o->_inverse_logic ? HIGH : LOW);
+    _tx_frame >>= 1;
+    _tx_when += o->_bit_ticks;
+    OCR2B = _tx_when >> 8;
+  }
+  else
+    TIMSK2 &= ~_BV(OCIE2B);
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+  SoftwareSerial::handle_rx_timer();
+}
+
+ISR(TIMER2_COMPB_vect)
+{
+  SoftwareSerial::handle_tx_timer();
+}
+#endif
+
 #if defined(PCINT0_vect)
 ISR(PCINT0_vect)
 {
@@ -370,6 +500,10 @@ void SoftwareSerial::setRX(uint8_t rx)
   _receiveBitMask = digitalPinToBitMask(rx);
   uint8_t port = digitalPinToPort(rx);
   _receivePortRegister = portInputRegister(port);
+#if _SS_TIMER_RX
+  _pcint_maskreg = digitalPinToPCMSK(rx);
+  _pcint_maskvalue = _BV(digitalPinToPCMSKbit(rx));
+#endif
 }
 
 //
@@ -404,6 +538,47 @@ void SoftwareSerial::begin(long speed)
     tunedDelay(_tx_delay); // if we were low this establishes the end
   }
 
+#if _SS_TIMER_RX
+  if (_rx_delay_stopbit)
+  {
+    // a character still going out keeps its speed
+    if (isListening())
+      while (_tx_bits)
+        ;
+
+    // the fastest Timer2 clock that counts a bit time in 8 bits
+    static const uint16_t prescale[] = { 1, 8, 32, 64, 128, 256, 1024 };
+    uint8_t i = 0;
+    while (i < 6 && F_CPU / speed / prescale[i] > 255)
+      ++i;
+    unsigned long clock = F_CPU / prescale[i];
+    _timer_clock = i + 1;
+    _bit_ticks = ((clock / speed) << 8) + ((clock % speed) << 8) / speed;
+    uint16_t latency = ((unsigned long)_SS_RX_LATENCY << 8) / prescale[i];
+    // OCR2A has to be set before the timer gets there
+    uint16_t ahead = (32UL << 8) / prescale[i];
+
+    // Too fast to sample the start bit, at 115200 baud: the first sample
+    // is of bit 0, and a glitch is taken for a character
+    _rx_start_bits = 10;
+    _rx_start_ticks = _bit_ticks / 2 - latency;
+    if (_bit_ticks / 2 < latency + ahead)
+    {
+      _rx_start_bits = 9;
+      _rx_start_ticks += _bit_ticks;
+    }
+
+    // a new speed for the object already listening
+    if (isListening())
+    {
+      uint8_t oldSREG = SREG;
+      cli();
+      setTimer();
+      SREG = oldSREG;
+    }
+  }
+#endif
+
 #if _DEBUG
   pinMode(_DEBUG_PIN1, OUTPUT);
   pinMode(_DEBUG_PIN2, OUTPUT);
@@ -416,6 +591,19 @@ void SoftwareSerial::end()
 {
   if (digitalPinToPCMSK(_receivePin))
     *digitalPinToPCMSK(_receivePin) &= ~_BV(digitalPinToPCMSKbit(_receivePin));
+#if _SS_TIMER_RX
+  if (isListening())
+  {
+    // let the last character's stop bit go out, the pin would stay low
+    while (_tx_bits)
+      ;
+    uint8_t oldSREG = SREG;
+    cli();
+    TIMSK2 &= ~(_BV(OCIE2A) | _BV(OCIE2B));
+    _rx_bits = _tx_bits = 0;
+    SREG = oldSREG;
+  }
+#endif
 }
 
 
@@ -450,6 +638,29 @@ size_t SoftwareSerial::write(uint8_t b)
     return 0;
   }
 
+#if _SS_TIMER_RX
+  // The listening object sends on the timer too, so that it can receive
+  // while it sends.  Others send as below, with interrupts off, and the
+  // timer misses any bit of the listening object's that falls meanwhile.
+  if (isListening())
+  {
+    // wait for the last character's stop bit
+    while (_tx_bits)
+      ;
+    uint8_t oldSREG = SREG;
+    cli();
+    tx_pin_write(_inverse_logic ? HIGH : LOW); // start bit
+    _tx_frame = b | 0x100; // 8 data bits, then the stop bit
+    _tx_when = ((uint16_t)TCNT2 << 8) + _bit_ticks;
+    OCR2B = _tx_when >> 8;
+    TIFR2 = _BV(OCF2B);
+    TIMSK2 |= _BV(OCIE2B);
+    _tx_bits = 10;
+    SREG = oldSREG;
+    return 1;
+  }
+#endif
+
   uint8_t oldSREG = SREG;
   cli();  // turn off interrupts for a clean txmit
 
@@ -40,6 +40,33 @@ http://arduiniana.org.
 ******************************************************************************/
 
 #define _SS_MAX_RX_BUFF 64 // RX buffer size
+
+// When set, a character is received one bit per Timer2 compare interrupt,
+// after the pin change interrupt finds its start bit, instead of in one
+// pin change interrupt that lasts the whole character.  Other interrupts
+// then wait a few microseconds at most, and the listening object sends on
+// the other compare unit while it receives.  Timer2 is taken over, so
+// analogWrite() on its pins and tone() can't be used.  Set it for the
+// whole build, the library's SoftwareSerial.cpp included; the class is
+// laid out the same either way.  The Arduino IDE has no way to pass a
+// define to a library, so there it is set by changing the default below.
+//
+// The members the timer needs cost each object 9 bytes of RAM whether or
+// not it is set.
+//
+// Objects that aren't listening still send with interrupts off for the
+// whole character.  The timer can't sample meanwhile, so a character
+// arriving for the listening object while another object sends is lost
+// or garbled.
+#ifndef _SS_TIMER_RX
+#define _SS_TIMER_RX 0
+#endif
+// Cycles from the start bit's edge to the pin change interrupt reading the
+// timer, plus from a compare match to its interrupt reading the pin.  They
+// are taken off the wait for the middle of the start bit.
+#ifndef _SS_RX_LATENCY
+#define _SS_RX_LATENCY 80
+#endif
 #ifndef GCC_VERSION
 #define GCC_VERSION (__GNUC__ * 10000 + __GNUC_MINOR__ * 100 + __GNUC_PATCHLEVEL__)
 #endif
@@ -62,6 +89,22 @@ private:
   uint16_t _buffer_overflow:1;
   uint16_t _inverse_logic:1;
 
+  // for _SS_TIMER_RX, kept without it so that the layout doesn't depend on it
+  uint16_t _bit_ticks;          // Timer2 ticks per bit, 8.8 fixed point
+  uint16_t _rx_start_ticks;     // from the pin change to the first sample
+  uint8_t _rx_start_bits;       // 10, or 9 when the start bit isn't sampled
+  uint8_t _timer_clock;         // Timer2 clock select bits
+  volatile uint8_t *_pcint_maskreg;
+  uint8_t _pcint_maskvalue;
+
+  // static data, the timer serves the listening object only
+  static volatile uint8_t _rx_bits; // bits of the character still to sample
+  static uint8_t _rx_byte;
+  static uint16_t _rx_when;     // next sample, Timer2 ticks 8.8
+  static volatile uint8_t _tx_bits; // bit times of the character still to send
+  static uint16_t _tx_frame;
+  static uint16_t _tx_when;
+
   // static data
   static char _receive_buffer[_SS_MAX_RX_BUFF]; 
   static volatile uint8_t _receive_buffer_tail;
@@ -74,6 +117,7 @@ private:
   void tx_pin_write(uint8_t pin_state);
   void setTX(uint8_t transmitPin);
   void setRX(uint8_t receivePin);
+  void setTimer();
 
   // private static method for timing
   static inline void tunedDelay(uint16_t delay);
@@ -98,6 +142,8 @@ public:
 
   // public only for easy access by interrupt handlers
   static inline void handle_interrupt();
+  static inline void handle_rx_timer();
+  static inline void handle_tx_timer();
 };
 
 // Arduino 0012 workaround
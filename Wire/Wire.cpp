@@ -241,6 +241,72 @@ BYTE TwoWire::endTransmission (void)
      return endTransmission (true) ;
 }
 
+//-----------------------------------------------------------------------------
+//                                                                      .submit
+//-----------------------------------------------------------------------------
+/*
+ *   submit() queues a transaction and returns at once, leaving the TWI 
+ *   interrupt to run it. Queued transactions are started one after another 
+ *   from the interrupt. Poll the transaction's status, which stays 
+ *   TWI_PENDING until it is done, or give it an onComplete callback. The 
+ *   callback runs in the interrupt and may submit again, but must not call 
+ *   the blocking functions such as endTransmission() or requestFrom(), which 
+ *   wait for the queue to empty.
+ *
+ *   Returns 0 once queued, 1 if the transaction is already in the queue.
+ */
+BYTE TwoWire::submit (twi_transaction * t)
+{
+     return twi_submit (t) ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                      .submit
+//-----------------------------------------------------------------------------
+/*
+ *   This variant of submit() fills the transaction in first: write txLength 
+ *   bytes to the slave at address, then read rxLength bytes back after a 
+ *   repeated start. Either length may be 0.
+ */
+BYTE TwoWire::submit (twi_transaction * t, BYTE address, const BYTE * txData, 
+                      uint16_t txLength, BYTE * rxData, uint16_t rxLength, 
+                      void (*onComplete)(twi_transaction *))
+{
+     t->address    = address ;
+     t->txData     = txData ;
+     t->txLength   = txLength ;
+     t->rxData     = rxData ;
+     t->rxLength   = rxLength ;
+     t->onComplete = onComplete ;
+     return twi_submit (t) ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                    .transfer
+//-----------------------------------------------------------------------------
+/*
+ *   transfer() writes txLength bytes from txData to the slave at address, 
+ *   then reads rxLength bytes into rxData after a repeated start, all in 
+ *   one bus transaction, and waits for it to finish. The bytes go straight 
+ *   between the buffers and the TWI, so neither length is limited to 
+ *   BUFFER_LENGTH and nothing is copied. Either length may be 0.
+ *
+ *   Returns the same codes as endTransmission().
+ */
+BYTE TwoWire::transfer (BYTE address, const BYTE * txData, uint16_t txLength, 
+                        BYTE * rxData, uint16_t rxLength)
+{
+     twi_transaction     t ;
+
+     t.address    = address ;
+     t.txData     = txData ;
+     t.txLength   = txLength ;
+     t.rxData     = rxData ;
+     t.rxLength   = rxLength ;
+     t.onComplete = NULL ;
+     return twi_transfer (& t) ;
+}
+
 //-----------------------------------------------------------------------------
 //                                                                       .write
 //-----------------------------------------------------------------------------
@@ -422,6 +488,74 @@ void TwoWire::onRequest (void (*function)(void))
      user_onRequest = function ;
 }
 
+//-----------------------------------------------------------------------------
+//                                                             .onReceiveStream
+//-----------------------------------------------------------------------------
+/*
+ *   onReceiveStream() has bytes written to this slave put into the ring 
+ *   buffer as they arrive, to be taken out with slaveRead(), so a write 
+ *   isn't limited to BUFFER_LENGTH bytes as long as the ring is read while 
+ *   it comes in. size is rounded down to a power of two up to 256, and the 
+ *   ring holds size - 1 bytes. A byte that finds the ring full is NACKed. 
+ *   function, if set, is called from the interrupt with the number of bytes 
+ *   once the master ends the write. The onReceive() handler isn't called 
+ *   while a ring is set. A NULL buffer goes back to onReceive().
+ */
+void TwoWire::onReceiveStream (BYTE * buffer, uint16_t size, void (*function)(int))
+{
+     twi_attachSlaveRxStream (buffer, size, function) ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                             .onRequestStream
+//-----------------------------------------------------------------------------
+/*
+ *   onRequestStream() sets a vector to be called from the interrupt for 
+ *   each byte a master reads from this slave, given the byte's index in 
+ *   the read. It returns the byte, or -1 when there are no more. Bytes go 
+ *   out as they are made, so a reply isn't limited to BUFFER_LENGTH and 
+ *   isn't copied. Each byte is asked for one ahead of sending it, so the 
+ *   last one asked for may not be read. The onRequest() handler isn't 
+ *   called while this is set. NULL goes back to onRequest().
+ */
+void TwoWire::onRequestStream (int (*function)(uint16_t))
+{
+     twi_attachSlaveTxStream (function) ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                              .slaveAvailable
+//-----------------------------------------------------------------------------
+/*
+ *   slaveAvailable() returns the number of bytes in the onReceiveStream() 
+ *   ring.
+ */
+int TwoWire::slaveAvailable (void)
+{
+     return twi_slaveAvailable () ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                   .slaveRead
+//-----------------------------------------------------------------------------
+/*
+ *   slaveRead() takes the next byte out of the onReceiveStream() ring, 
+ *   or returns -1 if it is empty. It doesn't disable interrupts, so bytes 
+ *   keep coming in while it runs.
+ */
+int TwoWire::slaveRead (void)
+{
+     return twi_slaveRead () ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                   .slavePeek
+//-----------------------------------------------------------------------------
+int TwoWire::slavePeek (void)
+{
+     return twi_slavePeek () ;
+}
+
 //-----------------------------------------------------------------------------
 //                                                       Preinstantiate Objects
 //-----------------------------------------------------------------------------
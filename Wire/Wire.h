@@ -49,6 +49,11 @@
 #include <inttypes.h>
 #include "Stream.h"
 
+extern "C"
+{
+     #include "utility/twi.h"
+}
+
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - -  Compile-Time Options
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Manifest Constants
@@ -91,6 +96,14 @@ public:
      uint8_t   requestFrom         (int, int, int) ;
      void      onReceive           (void (*)(int)) ;
      void      onRequest           (void (*)(void)) ;
+     void      onReceiveStream     (uint8_t *, uint16_t, void (*)(int) = NULL) ;
+     void      onRequestStream     (int (*)(uint16_t)) ;
+     int       slaveAvailable      (void) ;
+     int       slaveRead           (void) ;
+     int       slavePeek           (void) ;
+     uint8_t   submit              (twi_transaction *) ;
+     uint8_t   submit              (twi_transaction *, uint8_t, const uint8_t *, uint16_t, uint8_t *, uint16_t, void (*)(twi_transaction *) = NULL) ;
+     uint8_t   transfer            (uint8_t, const uint8_t *, uint16_t, uint8_t *, uint16_t) ;
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - Virtual Functions
      virtual size_t write          (uint8_t) ;
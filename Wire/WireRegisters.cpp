@@ -0,0 +1,301 @@
+//*****************************************************************************
+//
+//   TWI/I2C library for Wiring & Arduino
+//   Register cache for I2C devices.                          WireRegisters.cpp
+//
+//*****************************************************************************
+/*
+ *   Keeps a copy of a device's registers so that reads of registers that
+ *   only change when written are answered without the bus, and writes are
+ *   held back and sent as one burst per run of neighbouring registers.
+ */
+
+//*****************************************************************************
+//                                                                   Tech Notes
+//*****************************************************************************
+/*
+ *   Each register has a byte of flags. A register is served from the cache
+ *   when it is VALID and not VOLATILE. write() sets VALID and DIRTY unless
+ *   the cache already holds the value, in which case there is nothing to
+ *   send. flush() sends each run of DIRTY registers as one burst of at most
+ *   BUFFER_LENGTH - 1 registers, joining runs that are up to
+ *   WIRE_REGISTERS_GAP clean, cached registers apart.
+ *
+ *   Reads that need the bus fetch the span of registers that aren't
+ *   cached, straight into the cache with TwoWire::transfer(), in one
+ *   transaction with a repeated start.
+ */
+
+//*****************************************************************************
+//                                                             Copyright Claims
+//*****************************************************************************
+/*
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of the
+ *   License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ *   USA.
+ */
+
+//-----------------------------------------------------------------------------
+//                                                          Compiler Directives
+//-----------------------------------------------------------------------------
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - Include Libraries
+extern "C"
+{
+     #include <string.h>
+}
+
+#include "WireRegisters.h"
+
+//-----------------------------------------------------------------------------
+//                                                                    Functions
+//-----------------------------------------------------------------------------
+
+//=============================================================================
+//   Constructor                                                  WireRegisters
+//-----------------------------------------------------------------------------
+WireRegisters::WireRegisters (BYTE address, BYTE first, BYTE count,
+                              BYTE * values, BYTE * flags,
+                              uint32_t volatileMask, TwoWire & wire)
+     : wire (wire), values (values), flags (flags), address (address),
+       first (first), count (count), dirty (0)
+{
+     BYTE      i ;
+
+     for (i = 0 ; i < count ; i ++)
+     {
+          flags [i] = 0 ;
+          if (i < 32 && (volatileMask & (1UL << i)))
+               flags [i] = WIRE_REG_VOLATILE ;
+     }
+}
+
+//-----------------------------------------------------------------------------
+//                                                                .setVolatile
+//-----------------------------------------------------------------------------
+/*
+ *   setVolatile() marks registers that the device changes by itself, such
+ *   as status, counters and inputs. They are read from the device every
+ *   time.
+ */
+void WireRegisters::setVolatile (BYTE reg, BYTE n)
+{
+     BYTE      i ;
+
+     if (! inRange (reg, n))
+          return ;
+     for (i = reg - first ; n ; i ++, n --)
+          flags [i] |= WIRE_REG_VOLATILE ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                 .invalidate
+//-----------------------------------------------------------------------------
+/*
+ *   invalidate() forgets the cached values and any unsent writes, as after
+ *   the device has been reset.
+ */
+void WireRegisters::invalidate (void)
+{
+     BYTE      i ;
+
+     for (i = 0 ; i < count ; i ++)
+          flags [i] &= WIRE_REG_VOLATILE ;
+     dirty = 0 ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                       .read
+//-----------------------------------------------------------------------------
+/*
+ *   Returns the register's value, or -1 if it couldn't be read.
+ */
+int WireRegisters::read (BYTE reg)
+{
+     BYTE      value ;
+
+     if (read (reg, & value, 1))
+          return -1 ;
+     return value ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                       .read
+//-----------------------------------------------------------------------------
+/*
+ *   Reads count registers from reg on into buf, from the cache where it
+ *   can. Returns 0, or the endTransmission() code of the failed transfer.
+ */
+BYTE WireRegisters::read (BYTE reg, BYTE * buf, BYTE n)
+{
+     BYTE      i ;
+     BYTE      lo ;
+     BYTE      hi ;
+     BYTE      from ;
+     BYTE      ret ;
+
+     if (! inRange (reg, n))
+          return 4 ;
+     lo = reg - first ;
+     hi = lo + n ;
+// Find the span that has to come from the device
+     while (lo < hi && reusable (lo))
+          lo ++ ;
+     while (hi > lo && reusable (hi - 1))
+          hi -- ;
+     if (lo < hi)
+     {
+     // Pending writes go first
+          ret = flush () ;
+          if (ret)
+               return ret ;
+          from = first + lo ;
+          ret  = wire.transfer (address, & from, 1, values + lo, hi - lo) ;
+          if (ret)
+          {
+               for (i = lo ; i < hi ; i ++)
+                    flags [i] &= ~ WIRE_REG_VALID ;
+               return ret ;
+          }
+          for (i = lo ; i < hi ; i ++)
+               flags [i] |= WIRE_REG_VALID ;
+     }
+     memcpy (buf, values + (reg - first), n) ;
+     return 0 ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                      .write
+//-----------------------------------------------------------------------------
+/*
+ *   Sets the register in the cache, to be sent by flush(). Returns 4 if
+ *   reg isn't in the map, otherwise 0.
+ */
+BYTE WireRegisters::write (BYTE reg, BYTE value)
+{
+     BYTE      i ;
+
+     if (! inRange (reg, 1))
+          return 4 ;
+     i = reg - first ;
+// Check if the device has, or is about to have, this value
+     if ((flags [i] & WIRE_REG_DIRTY) || reusable (i))
+     {
+          if (values [i] == value)
+               return 0 ;
+     }
+     values [i] = value ;
+     if (! (flags [i] & WIRE_REG_DIRTY))
+          dirty ++ ;
+     flags [i] |= WIRE_REG_VALID | WIRE_REG_DIRTY ;
+     return 0 ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                      .write
+//-----------------------------------------------------------------------------
+BYTE WireRegisters::write (BYTE reg, const BYTE * buf, BYTE n)
+{
+     if (! inRange (reg, n))
+          return 4 ;
+     while (n --)
+          write (reg ++, * buf ++) ;
+     return 0 ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                     .modify
+//-----------------------------------------------------------------------------
+/*
+ *   modify() sets the bits of the register that are set in mask to those
+ *   of value, leaving the rest. A cached register isn't read first.
+ */
+BYTE WireRegisters::modify (BYTE reg, BYTE mask, BYTE value)
+{
+     BYTE      old ;
+     BYTE      ret ;
+
+     ret = read (reg, & old, 1) ;
+     if (ret)
+          return ret ;
+     return write (reg, (old & ~ mask) | (value & mask)) ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                      .flush
+//-----------------------------------------------------------------------------
+/*
+ *   Sends the registers written since the last flush(). Returns 0, or the
+ *   endTransmission() code of the first burst that failed, whose registers
+ *   are left to send next time.
+ */
+BYTE WireRegisters::flush (void)
+{
+     BYTE      i ;
+     BYTE      j ;
+     BYTE      end ;
+     BYTE      ret ;
+
+     i = 0 ;
+     while (dirty)
+     {
+     // Find the next dirty register
+          while (! (flags [i] & WIRE_REG_DIRTY))
+               i ++ ;
+     // Take in the dirty registers that follow, and those close enough
+     // across clean cached ones
+          end = i + 1 ;
+          for (j = end ; j < count && j - i < BUFFER_LENGTH - 1 ; j ++)
+          {
+               if (flags [j] & WIRE_REG_DIRTY)
+                    end = j + 1 ;
+               else if (! reusable (j) || j - end >= WIRE_REGISTERS_GAP)
+                    break ;
+          }
+     // Send the burst
+          wire.beginTransmission (address) ;
+          wire.write (first + i) ;
+          wire.write (values + i, end - i) ;
+          ret = wire.endTransmission () ;
+          if (ret)
+               return ret ;
+          for (j = i ; j < end ; j ++)
+          {
+               if (flags [j] & WIRE_REG_DIRTY)
+                    dirty -- ;
+               flags [j] &= ~ WIRE_REG_DIRTY ;
+          }
+          i = end ;
+     }
+     return 0 ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                    .inRange
+//-----------------------------------------------------------------------------
+BYTE WireRegisters::inRange (BYTE reg, BYTE n)
+{
+     return reg >= first && n <= count && reg - first <= count - n ;
+}
+
+//-----------------------------------------------------------------------------
+//                                                                   .reusable
+//-----------------------------------------------------------------------------
+/*
+ *   reusable() tells whether the cached value can stand in for the device.
+ */
+BYTE WireRegisters::reusable (BYTE index)
+{
+     return (flags [index] & (WIRE_REG_VALID | WIRE_REG_VOLATILE)) == WIRE_REG_VALID ;
+}
@@ -0,0 +1,126 @@
+//*****************************************************************************
+//
+//   TWI/I2C library for Wiring & Arduino
+//   Register cache for I2C devices.                            WireRegisters.h
+//
+//*****************************************************************************
+/*
+ *   Keeps a copy of a device's registers so that reads of registers that
+ *   only change when written are answered without the bus, and writes are
+ *   held back and sent as one burst per run of neighbouring registers.
+ */
+
+//*****************************************************************************
+//                                                             Copyright Claims
+//*****************************************************************************
+/*
+ *   This library is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation; either version 2.1 of the License, or (at
+ *   your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ *   License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this library; if not, write to the Free Software Foundation,
+ *   Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.
+ */
+
+//-----------------------------------------------------------------------------
+//                                        C O M P I L E R   D I R E C T I V E S
+//-----------------------------------------------------------------------------
+#ifndef WIREREGISTERS_H
+#define WIREREGISTERS_H
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - Include Libraries
+#include <inttypes.h>
+#include "Wire.h"
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - -  Compile-Time Options
+// Clean registers rewritten to join two dirty runs into one burst. Each one
+// costs a byte on the bus, a second burst costs a start, the address, the
+// register number and a stop.
+#ifndef WIRE_REGISTERS_GAP
+#define WIRE_REGISTERS_GAP 2
+#endif
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Manifest Constants
+#define WIRE_REG_VALID     0x01      // cached value is the device's
+#define WIRE_REG_DIRTY     0x02      // written, not yet sent
+#define WIRE_REG_VOLATILE  0x04      // changed by the device, always read
+
+//-----------------------------------------------------------------------------
+//   Class Declaration                                            WireRegisters
+//-----------------------------------------------------------------------------
+/*
+ *   Registers first to first + count - 1 of the slave at address, with the
+ *   cache held in the caller's values and flags arrays. WireRegisterMap
+ *   below provides the arrays. Registers are taken to auto-increment, as
+ *   most devices' do, so that a run of them is read or written in one
+ *   transaction.
+ *
+ *   write() only updates the cache; flush() sends what changed. A read
+ *   that has to go to the bus flushes first, so the device sees writes and
+ *   reads in the order they were made.
+ */
+class WireRegisters
+{
+public:
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Constructors
+               WireRegisters  (uint8_t address, uint8_t first, uint8_t count,
+                               uint8_t * values, uint8_t * flags,
+                               uint32_t volatileMask, TwoWire & wire) ;
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Public Functions
+     void      setVolatile    (uint8_t reg, uint8_t count = 1) ;
+     void      invalidate     (void) ;
+     int       read           (uint8_t reg) ;
+     uint8_t   read           (uint8_t reg, uint8_t * buf, uint8_t count) ;
+     uint8_t   write          (uint8_t reg, uint8_t value) ;
+     uint8_t   write          (uint8_t reg, const uint8_t * buf, uint8_t count) ;
+     uint8_t   modify         (uint8_t reg, uint8_t mask, uint8_t value) ;
+     uint8_t   flush          (void) ;
+
+private:
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - Private Functions
+     uint8_t   inRange        (uint8_t reg, uint8_t count) ;
+     uint8_t   reusable       (uint8_t index) ;
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Private Data
+     TwoWire & wire ;
+     uint8_t * values ;
+     uint8_t * flags ;
+     uint8_t   address ;
+     uint8_t   first ;
+     uint8_t   count ;
+     uint8_t   dirty ;               // registers waiting for flush()
+} ;
+
+//-----------------------------------------------------------------------------
+//   Template Class Declaration                                 WireRegisterMap
+//-----------------------------------------------------------------------------
+/*
+ *   WireRegisters with room for COUNT registers. Bit n of volatileMask
+ *   marks register first + n volatile, setVolatile() covers the rest.
+ *
+ *        WireRegisterMap <8> ds1307 (0x68, 0x00, 0x7F) ;
+ */
+template <uint8_t COUNT> class WireRegisterMap : public WireRegisters
+{
+public:
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Constructors
+               WireRegisterMap (uint8_t address, uint8_t first = 0,
+                                uint32_t volatileMask = 0, TwoWire & wire = Wire)
+                    : WireRegisters (address, first, COUNT, valueStore,
+                                     flagStore, volatileMask, wire) {}
+
+private:
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -  Private Data
+     uint8_t   valueStore [COUNT] ;
+     uint8_t   flagStore [COUNT] ;
+} ;
+
+#endif
@@ -0,0 +1,58 @@
+// Wire Slave Stream
+// Demonstrates use of the Wire library
+// Receives and sends frames longer than the Wire buffer as an I2C/TWI slave
+// Bytes written by the master go into a ring buffer as they arrive and are
+// read in loop(), and bytes the master reads are made one at a time
+// Refer to the "Wire Master Writer" and "Wire Master Reader" examples for
+// use with this
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+uint8_t ring[64];               // holds 63 bytes, read as they come in
+char status[100];               // longer than the 32 byte Wire buffer
+volatile byte framesEnded;      // writes ended by the master
+byte framesPrinted;
+
+void setup()
+{
+  Wire.begin(4);                // join i2c bus with address #4
+  Wire.onReceiveStream(ring, sizeof(ring), receiveEnd);
+  Wire.onRequestStream(requestByte);
+  Serial.begin(9600);           // start serial for output
+  for (int i = 0; i < sizeof(status) - 1; i++)
+    status[i] = 'a' + i % 26;
+}
+
+void loop()
+{
+  // a frame's bytes are all in the ring before its end is counted
+  byte ended = framesEnded;
+  int c;
+
+  // the frame can be any length, as long as it is read while it arrives
+  while ((c = Wire.slaveRead()) >= 0)
+    Serial.print((char)c);
+  if (ended != framesPrinted) {
+    framesPrinted = ended;
+    Serial.println();
+  }
+}
+
+// function that executes whenever the master ends a write
+// this function is registered as an event, see setup()
+void receiveEnd(int howMany)
+{
+  framesEnded++;
+}
+
+// function that executes for each byte the master reads
+// this function is registered as an event, see setup()
+int requestByte(uint16_t index)
+{
+  if (index < sizeof(status) - 1)
+    return status[index];
+  return -1;                    // no more
+}
@@ -37,12 +37,38 @@
   #define TWI_MTX   2
   #define TWI_SRX   3
   #define TWI_STX   4
-  
+
+  #define TWI_PENDING 0xFF
+
+  // A master transaction for twi_submit(): writes txLength bytes, then, after
+  // a repeated start, reads rxLength bytes, then sends a stop.  Either part
+  // may be empty, and neither is limited to TWI_BUFFER_LENGTH.  The buffers belong to the caller and must stay valid
+  // until status is no longer TWI_PENDING.  status then holds the same codes
+  // as twi_writeTo().  onComplete, if set, is called from the TWI interrupt.
+  typedef struct twi_transaction {
+    struct twi_transaction* next;
+    uint8_t address;
+    const uint8_t* txData;
+    uint16_t txLength;
+    uint8_t* rxData;
+    uint16_t rxLength;
+    void (*onComplete)(struct twi_transaction*);
+    void* arg;
+    volatile uint8_t status;
+  } twi_transaction;
+
   void twi_init(void);
   void twi_setAddress(uint8_t);
   uint8_t twi_readFrom(uint8_t, uint8_t*, uint8_t, uint8_t);
   uint8_t twi_writeTo(uint8_t, uint8_t*, uint8_t, uint8_t, uint8_t);
+  uint8_t twi_submit(twi_transaction*);
+  uint8_t twi_transfer(twi_transaction*);
   uint8_t twi_transmit(const uint8_t*, uint8_t);
+  void twi_attachSlaveRxStream(uint8_t*, uint16_t, void (*)(int));
+  void twi_attachSlaveTxStream( int (*)(uint16_t) );
+  uint8_t twi_slaveAvailable(void);
+  int twi_slaveRead(void);
+  int twi_slavePeek(void);
   void twi_attachSlaveRxEvent( void (*)(uint8_t*, int) );
   void twi_attachSlaveTxEvent( void (*)(void) );
   void twi_reply(uint8_t);